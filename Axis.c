@@ -0,0 +1,248 @@
+#include "Axis.h"
+
+
+//one trapezoid pulse generator per axis
+typedef struct{
+ long steps;           // steps in the move
+ long steps_done;      // steps output so far
+ int accel_steps;      // length of the ramp, mirrored for decel
+ int dir;              // +1 or -1 added to the machine position
+ volatile char busy;   // cleared by the OC isr, polled by the main loop
+ unsigned short ramp[AXIS_RAMP_SIZE]; // periods in axis timer ticks
+}Axis_Gen;
+
+static Axis_Gen gen[N_AXIS];
+//set while the step pins are mapped to the OC modules
+static char pins_mapped;
+
+/////////////////////////////////////////////////////
+//stop the OC/TMR pair for the axis
+static void axis_stop(int axis){
+  switch(axis){
+     case X_AXIS: OC5IE_bit = 0; OC5CONCLR = 0x8000; T2CONCLR = 0x8000; break;
+     case Y_AXIS: OC2IE_bit = 0; OC2CONCLR = 0x8000; T4CONCLR = 0x8000; break;
+     case Z_AXIS: OC7IE_bit = 0; OC7CONCLR = 0x8000; T6CONCLR = 0x8000; break;
+     case A_AXIS: OC3IE_bit = 0; OC3CONCLR = 0x8000; T5CONCLR = 0x8000; break;
+  }
+  gen[axis].busy = 0;
+}
+
+/////////////////////////////////////////////////////
+//OCx in dual compare continuous pulse mode, the pulse
+//rises at OCxR and falls at OCxRS once every PRx. The
+//rise is held back by the direction setup time so the
+//first step comes that long after the direction pins
+//were written, the pulses after it keep the same phase
+static void axis_start(int axis,unsigned int period){
+unsigned int rise,fall;
+  rise = 1 + st_get_axis_dir_setup_ticks();
+  fall = rise + st_get_pulse_ticks();
+  switch(axis){
+     case X_AXIS:
+          OC5CON = 0x0005; OC5R = rise; OC5RS = fall;
+          PR2 = period; TMR2 = 0; OC5IF_bit = 0; OC5IE_bit = 1;
+          OC5CONSET = 0x8000; T2CONSET = 0x8000;
+          break;
+     case Y_AXIS:
+          OC2CON = 0x0005; OC2R = rise; OC2RS = fall;
+          PR4 = period; TMR4 = 0; OC2IF_bit = 0; OC2IE_bit = 1;
+          OC2CONSET = 0x8000; T4CONSET = 0x8000;
+          break;
+     case Z_AXIS:
+          OC7CON = 0x0005; OC7R = rise; OC7RS = fall;
+          PR6 = period; TMR6 = 0; OC7IF_bit = 0; OC7IE_bit = 1;
+          OC7CONSET = 0x8000; T6CONSET = 0x8000;
+          break;
+     case A_AXIS:
+          OC3CON = 0x000D; OC3R = rise; OC3RS = fall;
+          PR5 = period; TMR5 = 0; OC3IF_bit = 0; OC3IE_bit = 1;
+          OC3CONSET = 0x8000; T5CONSET = 0x8000;
+          break;
+  }
+}
+
+/////////////////////////////////////////////////////
+//hand the step pins to the OC modules or back to the DDA
+static void axis_map_pins(char to_oc){
+#ifdef STEP_PULSE_OC
+  //the pins stay on the OC modules, the DDA only needs the
+  //modules put back in single pulse mode
+  if(!to_oc)
+     st_pulse_init();
+#else
+  Unlock_IOLOCK();
+  if(to_oc){
+     PPS_Mapping_NoLock(_RPD4, _OUTPUT, _OC5);     //X_Axis TMR2
+     PPS_Mapping_NoLock(_RPD5, _OUTPUT, _OC2);     //Y_Axis TMR4
+     PPS_Mapping_NoLock(_RPF0, _OUTPUT, _OC7);     //Z_Axis TMR6
+     PPS_Mapping_NoLock(_RPF1, _OUTPUT, _OC3);     //A_Axis TMR5
+  }else{
+     PPS_Mapping_NoLock(_RPD4, _OUTPUT, _NULL);
+     PPS_Mapping_NoLock(_RPD5, _OUTPUT, _NULL);
+     PPS_Mapping_NoLock(_RPF0, _OUTPUT, _NULL);
+     PPS_Mapping_NoLock(_RPF1, _OUTPUT, _NULL);
+  }
+  Lock_IOLOCK();
+#endif
+  pins_mapped = to_oc;
+}
+
+void Init_Axis(){
+int i;
+  OutPutPulseXYZ();
+  for(i = 0; i < N_AXIS; i++)
+     axis_stop(i);
+  axis_map_pins(0);
+}
+
+/* Build the axis ramp with the Austin recurrence, the first period
+ * is 0.676 * f * sqrt(2/a) and each following one is
+ * c[n] = c[n-1] - 2c[n-1]/(4n+1) in Q8 fixed point until the
+ * axis max rate or half the move is reached.
+ */
+static void axis_plan_ramp(int axis){
+Axis_Gen *g;
+float accel,rate;
+long c,c_min;
+int n;
+  g = &gen[axis];
+  accel = plan_get_acceleration(axis) * plan_get_steps_per_mm(axis);
+  rate  = plan_get_max_rate(axis) / 60.0f * plan_get_steps_per_mm(axis);
+  c     = (long)(0.676f * AXIS_TIMER_FREQ * f_sqrt(2.0f / accel));
+  c_min = (long)(AXIS_TIMER_FREQ / rate);
+  if(c_min < AXIS_MIN_PERIOD)
+     c_min = AXIS_MIN_PERIOD;
+  if(c_min < 2 * (long)st_get_pulse_ticks())
+     c_min = 2 * (long)st_get_pulse_ticks();
+  //the delayed pulse has to fall inside the shortest period
+  if(c_min < 2 + (long)st_get_axis_dir_setup_ticks() + (long)st_get_pulse_ticks())
+     c_min = 2 + (long)st_get_axis_dir_setup_ticks() + (long)st_get_pulse_ticks();
+  if(c > AXIS_MAX_PERIOD)
+     c = AXIS_MAX_PERIOD;
+  if(c < c_min)
+     c = c_min;
+
+  c <<= 8;
+  c_min <<= 8;
+  g->ramp[0] = (unsigned short)(c >> 8);
+  n = 0;
+  while((c > c_min) && (n < AXIS_RAMP_SIZE-1) && (n < (g->steps >> 1))){
+     n++;
+     c -= (c << 1) / ((long)n * 4 + 1);
+     if(c < c_min)
+        c = c_min;
+     g->ramp[n] = (unsigned short)(c >> 8);
+  }
+  g->accel_steps = n;
+}
+
+/* Called from the axis OC isr after each pulse, returns the period
+ * for the next one from the ramp so no division is done here. Step
+ * n of the move is timed by ramp[n] speeding up and by ramp[steps-1-n]
+ * slowing down, so the last step is ramp[0] as the first one is.
+ */
+static unsigned int axis_next_period(int axis){
+Axis_Gen *g;
+long idx;
+  g = &gen[axis];
+  g->steps_done++;
+  st_add_position(axis,g->dir);
+  if(g->steps_done >= g->steps){
+     axis_stop(axis);
+     return AXIS_MAX_PERIOD;
+  }
+  idx = g->steps - 1 - g->steps_done;
+  if(idx > g->steps_done)
+     idx = g->steps_done;
+  if(idx < g->accel_steps)
+     return g->ramp[idx];
+  return g->ramp[g->accel_steps];
+}
+
+/* Start an independent move on every axis to the target in mm,
+ * each axis runs at its own max rate and acceleration so the move
+ * does not follow a straight line. Only starts from idle, returns
+ * 0 if the planner or a generator is still busy. The steps are
+ * counted from the machine position, which the empty queue ends at,
+ * and the isrs add each one to it. Nothing may be queued until
+ * Axis_Release() has put the planner where the axes stopped.
+ */
+int Axis_Rapid(float *target){
+long delta[N_AXIS],position[N_AXIS];
+unsigned char dir_bits;
+int i;
+
+  if(Axis_Busy() || st_is_busy() || (plan_get_current_block() != NULL))
+     return 0;
+
+  st_get_position(position);
+  dir_bits = 0;
+  for(i = 0; i < N_AXIS; i++){
+     delta[i] = plan_mm_to_steps(target[i],i) - position[i];
+     if(delta[i] < 0)
+        bit_true(dir_bits,bit(i));
+  }
+
+  LATGSET = dir_lat_g[dir_bits];
+  LATGCLR = DIR_MASK_G ^ dir_lat_g[dir_bits];
+  LATESET = dir_lat_e[dir_bits];
+  LATECLR = DIR_MASK_E ^ dir_lat_e[dir_bits];
+
+  axis_map_pins(1);
+  for(i = 0; i < N_AXIS; i++){
+     gen[i].steps = labs(delta[i]);
+     gen[i].steps_done = 0;
+     gen[i].dir = (delta[i] < 0)? -1 : 1;
+     if(gen[i].steps == 0)
+        continue;
+     axis_plan_ramp(i);
+     gen[i].busy = 1;
+  }
+  //start together once all the ramps are built
+  for(i = 0; i < N_AXIS; i++){
+     if(gen[i].busy)
+        axis_start(i,gen[i].ramp[0]);
+  }
+  return 1;
+}
+
+int Axis_Busy(){
+  return gen[X_AXIS].busy || gen[Y_AXIS].busy ||
+         gen[Z_AXIS].busy || gen[A_AXIS].busy;
+}
+
+/* Hand the step pins back to the DDA once every generator is done
+ * and start planning again from where the axes stopped, returns 0
+ * while an independent move is still running.
+ */
+int Axis_Release(){
+  if(Axis_Busy())
+     return 0;
+  if(pins_mapped){
+     axis_map_pins(0);
+     plan_sync_position();
+  }
+  return 1;
+}
+
+/////////////////////////////////////////////////////
+//OC interrupts fire on the falling edge of each pulse
+void OC5_Interrupt() iv IVT_OUTPUT_COMPARE_5 ilevel 3 ics ICS_AUTO {
+  OC5IF_bit = 0;
+  PR2 = axis_next_period(X_AXIS);
+}
+
+void OC2_Interrupt() iv IVT_OUTPUT_COMPARE_2 ilevel 3 ics ICS_AUTO {
+  OC2IF_bit = 0;
+  PR4 = axis_next_period(Y_AXIS);
+}
+
+void OC7_Interrupt() iv IVT_OUTPUT_COMPARE_7 ilevel 3 ics ICS_AUTO {
+  OC7IF_bit = 0;
+  PR6 = axis_next_period(Z_AXIS);
+}
+
+void OC3_Interrupt() iv IVT_OUTPUT_COMPARE_3 ilevel 3 ics ICS_AUTO {
+  OC3IF_bit = 0;
+  PR5 = axis_next_period(A_AXIS);
+}
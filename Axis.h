@@ -0,0 +1,29 @@
+#ifndef AXIS_H
+#define AXIS_H
+
+#include "Config.h"
+#include "built_in.h"
+
+////////////////////////////////////////////////////
+//DEFINES
+//G0 rapids run each axis on its own OC/TMR pair with its own
+//trapezoid instead of the coordinated planner, comment out to
+//keep rapids on the planner
+#define INDEPENDENT_RAPIDS
+
+//TMR2..7 run from PBCLK3 50MHz / 8 = 0.16us tick
+#define AXIS_TIMER_FREQ 6250000
+//shortest period allowed, must stay above the pulse width
+#define AXIS_MIN_PERIOD 32
+#define AXIS_MAX_PERIOD 0xFFFF
+//max number of accel steps held in each axis ramp table
+#define AXIS_RAMP_SIZE 1024
+
+////////////////////////////////////////////////////
+//function prototypes
+void Init_Axis();
+int  Axis_Rapid(float *target);
+int  Axis_Busy();
+int  Axis_Release();
+
+#endif
@@ -0,0 +1,610 @@
+#include "Gcode.h"
+
+Gcode_State gc;
+Gcode_Block gc_block;
+
+/* Sum the selected G54..G59 offset, G92 and the tool length on Z
+ * into the one vector used for every block. Only called when one
+ * of them changes.
+ */
+static void gc_update_offsets(){
+float *coord;
+int i;
+  coord = settings.coord_data[gc.coord_select];
+  for(i = 0; i < N_AXIS; i++)
+     gc.work_offset[i] = coord[i] + gc.g92_offset[i];
+  gc.work_offset[Z_AXIS] += settings.tool_length[gc.tool_select];
+}
+
+//G0, G17, G90, G54, G49 and no G92 at power up, the machine is at 0
+void gc_init(){
+  memset(gc.g92_offset,0,sizeof(gc.g92_offset));
+  memset(gc.position,0,sizeof(gc.position));
+  gc.motion_mode = MOTION_MODE_SEEK;
+  gc.plane_axis_0 = X_AXIS;
+  gc.plane_axis_1 = Y_AXIS;
+  gc.absolute_mode = 1;
+  gc.feed_rate = 0.0f;
+  gc.coord_select = 0;
+  gc.tool_select = 0;
+  gc.program_flow = PROGRAM_FLOW_RUNNING;
+  gc.optional_stop = 0;
+  gc.spindle = SPINDLE_OFF;
+  gc.spindle_speed = 0.0f;
+  gc_update_offsets();
+}
+
+//end of the last block in work coords
+static void gc_get_work_position(float *position){
+  memcpy(position,gc.position,sizeof(gc.position));
+  gc_machine_to_work(position);
+}
+
+/* G10 L2 sets the P1..P6 work offset to the axis words, P0 is the
+ * one in use. L20 sets it so the end of the queue reads as the axis
+ * words. L1 sets the length of tool P to the Z word. The value is
+ * saved to flash, which stalls the cpu, so the moves queued ahead
+ * of it are run out first.
+ */
+static int gc_set_data(){
+float coord_data[N_AXIS],position[N_AXIS];
+int coord_select,i;
+  mc_synchronize();
+  if(gc_block.l == 1){
+     if(!bit_istrue(gc_block.axis_words,bit(Z_AXIS)))
+        return 0;
+     return gc_set_tool_length((int)gc_block.p,gc_block.xyz[Z_AXIS]);
+  }
+  if((gc_block.l != 2) && (gc_block.l != 20))
+     return 0;
+  coord_select = (int)gc_block.p - 1;
+  if(coord_select < 0)
+     coord_select = gc.coord_select;
+  if(!settings_read_coord_data(coord_select,coord_data))
+     return 0;
+  if(gc_block.l == 20)
+     memcpy(position,gc.position,sizeof(position));
+  for(i = 0; i < N_AXIS; i++){
+     if(!bit_istrue(gc_block.axis_words,bit(i)))
+        continue;
+     if(gc_block.l == 2)
+        coord_data[i] = gc_block.xyz[i];
+     else
+        coord_data[i] = position[i] - gc_block.xyz[i] - gc.work_offset[i] +
+                        settings.coord_data[gc.coord_select][i];
+  }
+  return gc_set_coord_data(coord_select,coord_data);
+}
+
+//G0, G28 and G30, on the axis generators when they are built in
+static void gc_rapid(float *target){
+#ifdef INDEPENDENT_RAPIDS
+  if(mc_rapid(target))
+     return;
+#endif
+  mc_line(target,RAPID_FEED_RATE);
+}
+
+/* G28 and G30 go through the axis words, if any, then to the stored
+ * position. With axis words only those axes go on to the stored
+ * position, as grbl does.
+ */
+static void gc_go_predefined(int coord_select){
+float target[N_AXIS];
+int i;
+  memcpy(target,gc.position,sizeof(target));
+  for(i = 0; i < N_AXIS; i++){
+     if(bit_istrue(gc_block.axis_words,bit(i)))
+        target[i] = gc_block.xyz[i] + gc.work_offset[i];
+  }
+  gc_rapid(target);
+  for(i = 0; i < N_AXIS; i++){
+     if(!gc_block.axis_words || bit_istrue(gc_block.axis_words,bit(i)))
+        target[i] = settings.coord_data[coord_select][i];
+  }
+  gc_rapid(target);
+  memcpy(gc.position,target,sizeof(target));
+}
+
+/* Non-modal G codes, action is the G number times 10 so G92.1 is
+ * 921. G4 is queued as a timed block and returns at once. Returns
+ * 0 for an unknown action or a bad word.
+ */
+int Modal_Group_Actions0(int action){
+float position[N_AXIS];
+int i;
+  switch(action){
+     case 40:  //G4 P secs
+          if(gc_block.p < 0.0f)
+             return 0;
+          if(gc_block.p > 0.0f)
+             mc_dwell(gc_block.p);
+          return 1;
+     case 100: //G10
+          return gc_set_data();
+     case 280: //G28
+          gc_go_predefined(SETTING_INDEX_G28);
+          return 1;
+     case 281: //G28.1, saved to flash once the queue has run out
+          mc_synchronize();
+          plan_get_position(position);
+          return settings_write_coord_data(SETTING_INDEX_G28,position);
+     case 300: //G30
+          gc_go_predefined(SETTING_INDEX_G30);
+          return 1;
+     case 301: //G30.1
+          mc_synchronize();
+          plan_get_position(position);
+          return settings_write_coord_data(SETTING_INDEX_G30,position);
+     case 530: //G53
+          gc_block.absolute_override = 1;
+          return 1;
+     case 920: //G92
+          gc_get_work_position(position);
+          for(i = 0; i < N_AXIS; i++){
+             if(bit_istrue(gc_block.axis_words,bit(i)))
+                position[i] = gc_block.xyz[i];
+          }
+          gc_set_g92(position);
+          return 1;
+     case 921: //G92.1
+          gc_clear_g92();
+          return 1;
+  }
+  return 0;
+}
+
+/* M0 and M1 queue a hold, the path stops where the M code is and
+ * the input carries on filling the queue behind it until
+ * st_cycle_start(). M2 and M30 end the program, the modal state is
+ * reset to G1, G17, G90, G54 and M5 now. The moves already queued
+ * are in machine coords and run out as planned with the spindle
+ * turned off behind them.
+ */
+int Modal_Group_Actions4(int action){
+  switch(action){
+     case 1:
+          if(!gc.optional_stop)
+             return 1;
+          //optional stop is on, hold as M0
+     case 0:
+          mc_dwell(DWELL_HOLD);
+          return 1;
+     case 2:
+     case 30:
+          gc.spindle = SPINDLE_OFF;
+          mc_spindle(SPINDLE_OFF,0.0f);
+          gc.motion_mode = MOTION_MODE_LINEAR;
+          gc.plane_axis_0 = X_AXIS;
+          gc.plane_axis_1 = Y_AXIS;
+          gc.absolute_mode = 1;
+          gc.coord_select = 0;
+          gc_update_offsets();
+          gc.program_flow = PROGRAM_FLOW_COMPLETED;
+          return 1;
+  }
+  return 0;
+}
+
+/* M3 clockwise, M4 counter clockwise and M5 off, action is the M
+ * number. The change is queued with the moves, nothing waits for
+ * the queue to empty. Returns 0 for anything else.
+ */
+int Modal_Group_Actions7(int action){
+  switch(action){
+     case 3: gc.spindle = SPINDLE_CW;  break;
+     case 4: gc.spindle = SPINDLE_CCW; break;
+     case 5: gc.spindle = SPINDLE_OFF; break;
+     default: return 0;
+  }
+  mc_spindle(gc.spindle,gc.spindle_speed);
+  return 1;
+}
+
+//S word, queued at once if the spindle is turning
+void gc_set_spindle_speed(float rpm){
+  if(rpm == gc.spindle_speed)
+     return;
+  gc.spindle_speed = rpm;
+  if(gc.spindle != SPINDLE_OFF)
+     mc_spindle(gc.spindle,gc.spindle_speed);
+}
+
+//G54..G59 are action 54..59, returns 0 for anything else
+int Modal_Group_Actions12(int action){
+  if((action < 54) || (action > 59))
+     return 0;
+  gc.coord_select = action - 54;
+  gc_update_offsets();
+  return 1;
+}
+
+//G10 L2, coord_select 0..5 for P1..P6, saved to flash once the
+//queue has run out
+int gc_set_coord_data(int coord_select,float *offset){
+int saved;
+  if((coord_select < 0) || (coord_select >= N_COORD_SYSTEM))
+     return 0;
+  mc_synchronize();
+  saved = settings_write_coord_data(coord_select,offset);
+  if(coord_select == gc.coord_select)
+     gc_update_offsets();
+  return saved;
+}
+
+/* G92, offset the work coords so the end of the last block reads as
+ * work_position, axes not programmed are passed at their current
+ * work position. Lines held back for fitting or blending are already
+ * in machine coords and are left where they are. Nothing is written
+ * to flash so the moves run on.
+ */
+void gc_set_g92(float *work_position){
+float *coord;
+int i;
+  coord = settings.coord_data[gc.coord_select];
+  for(i = 0; i < N_AXIS; i++)
+     gc.g92_offset[i] = gc.position[i] - coord[i] - work_position[i];
+  gc.g92_offset[Z_AXIS] -= settings.tool_length[gc.tool_select];
+  gc_update_offsets();
+}
+
+//G92.1
+void gc_clear_g92(){
+  memset(gc.g92_offset,0,sizeof(gc.g92_offset));
+  gc_update_offsets();
+}
+
+//G43 H tool, 0 is G49. Lengths come from the settings tool table
+int gc_set_tool_offset(int tool){
+  if((tool < 0) || (tool >= N_TOOL))
+     return 0;
+  gc.tool_select = tool;
+  gc_update_offsets();
+  return 1;
+}
+
+//G10 L1, saves a tool length once the queue has run out, tool 0
+//stays 0
+int gc_set_tool_length(int tool,float length){
+int saved;
+  if((tool < 1) || (tool >= N_TOOL))
+     return 0;
+  mc_synchronize();
+  saved = settings_write(SETTING_TOOL_LENGTH + tool,length);
+  if(tool == gc.tool_select)
+     gc_update_offsets();
+  return saved;
+}
+
+//work position to machine position in place, one add per axis,
+//G53 axis words are machine coords already
+void gc_work_to_machine(float *target){
+int i;
+  if(gc_block.absolute_override)
+     return;
+  for(i = 0; i < N_AXIS; i++)
+     target[i] += gc.work_offset[i];
+}
+
+//machine position to work position in place for reports
+void gc_machine_to_work(float *position){
+int i;
+  for(i = 0; i < N_AXIS; i++)
+     position[i] -= gc.work_offset[i];
+}
+
+/* The block's move from the end of the last one to target in
+ * machine coords, in the modal motion mode. The arc radius is taken
+ * from the centre offset.
+ */
+static void gc_move(float *target){
+float offset_2[2],radius,u,v;
+  switch(gc.motion_mode){
+     case MOTION_MODE_SEEK:
+          gc_rapid(target);
+          break;
+     case MOTION_MODE_LINEAR:
+          mc_line(target,gc.feed_rate);
+          break;
+     case MOTION_MODE_CW_ARC:
+     case MOTION_MODE_CCW_ARC:
+          u = gc_block.ijk[gc.plane_axis_0];
+          v = gc_block.ijk[gc.plane_axis_1];
+          radius = f_sqrt(u * u + v * v);
+          mc_arc(target,gc_block.ijk,radius,gc.feed_rate,
+                 gc.motion_mode == MOTION_MODE_CW_ARC,
+                 gc.plane_axis_0,gc.plane_axis_1);
+          break;
+     case MOTION_MODE_SPLINE:
+          offset_2[0] = gc_block.p;
+          offset_2[1] = gc_block.q;
+          mc_spline(target,gc_block.ijk,offset_2,gc.feed_rate);
+          break;
+  }
+  memcpy(gc.position,target,sizeof(gc.position));
+}
+
+/* One block of G code. Words may run together as in G1X10Y5F600,
+ * spaces, (comments) and anything after a ; are skipped and lower
+ * case is read as upper case. All the words are read and checked
+ * before anything is run, then the block runs in the order grbl
+ * uses: F, S, M3/M4/M5, G4, G17..G19, G43/G49, G54..G59, G61/G64,
+ * G90/G91, the other non-modal codes, the move and last
+ * M0/M1/M2/M30. G10, G28, G30 and G92 take the axis words and there
+ * is no move then. G7 is a raster scan line for this block only, its
+ * D word is the rest of the line and its S is the power of this line
+ * only. Returns 0 for a word that is bad or not supported, or if an
+ * action fails.
+ */
+int gc_execute_line(char *line){
+float target[N_AXIS],value,rpm;
+int char_counter,code,axis_0,axis_1,move,i;
+int non_modal,motion_mode,plane,tool,coord_select;
+int path_mode,distance,stop,spindle;
+char letter,raster;
+
+  memset(&gc_block,0,sizeof(gc_block));
+  non_modal = motion_mode = plane = tool = coord_select = -1;
+  path_mode = distance = stop = spindle = -1;
+  raster = 0;
+  char_counter = 0;
+  while(1){
+     letter = line[char_counter];
+     if((letter == 0) || (letter == ';'))
+        break;
+     if((letter == ' ') || (letter == '\t') ||
+        (letter == '\r') || (letter == '\n')){
+        char_counter++;
+        continue;
+     }
+     if(letter == '('){
+        while(line[char_counter] && (line[char_counter] != ')'))
+           char_counter++;
+        if(line[char_counter])
+           char_counter++;
+        continue;
+     }
+     if((letter >= 'a') && (letter <= 'z'))
+        letter -= 'a' - 'A';
+     if((letter < 'A') || (letter > 'Z'))
+        return 0;
+     char_counter++;
+     if(letter == 'D'){
+        gc_block.data = line + char_counter;
+        break;
+     }
+     if(!read_float(line,&char_counter,&value))
+        return 0;
+     //G92.1 is 921 and M30 is 300
+     code = round(value * 10.0f);
+
+     switch(letter){
+        case 'G':
+             switch(code){
+                case 0: case 10: case 20: case 30: case 50:
+                     motion_mode = code / 10;
+                     break;
+                case 70:
+                     raster = 1;
+                     break;
+                case 40: case 100: case 280: case 281: case 300:
+                case 301: case 530: case 920: case 921:
+                     if(non_modal >= 0)
+                        return 0;
+                     non_modal = code;
+                     break;
+                case 170: case 180: case 190:
+                     plane = code / 10;
+                     break;
+                case 430: case 490:
+                     tool = code / 10;
+                     break;
+                case 540: case 550: case 560: case 570: case 580: case 590:
+                     coord_select = code / 10;
+                     break;
+                case 610: case 640:
+                     path_mode = code / 10;
+                     break;
+                case 900: case 910:
+                     distance = code / 10;
+                     break;
+                case 210: case 940:
+                     //mm and mm/min are all there is
+                     break;
+                default:
+                     return 0;
+             }
+             break;
+        case 'M':
+             switch(code){
+                case 0: case 10: case 20: case 300:
+                     stop = code / 10;
+                     break;
+                case 30: case 40: case 50:
+                     spindle = code / 10;
+                     break;
+                default:
+                     return 0;
+             }
+             break;
+        case 'N':
+             break;
+        case 'X': case 'Y': case 'Z': case 'A':
+             i = (letter == 'A')? A_AXIS : letter - 'X';
+             gc_block.xyz[i] = value;
+             bit_true(gc_block.axis_words,bit(i));
+             break;
+        case 'I': case 'J': case 'K':
+             i = letter - 'I';
+             gc_block.ijk[i] = value;
+             bit_true(gc_block.words,bit(WORD_I) << i);
+             break;
+        case 'F':
+             if(value <= 0.0f)
+                return 0;
+             gc_block.f = value;
+             bit_true(gc_block.words,bit(WORD_F));
+             break;
+        case 'H':
+             gc_block.h = (int)value;
+             bit_true(gc_block.words,bit(WORD_H));
+             break;
+        case 'L':
+             gc_block.l = (int)value;
+             bit_true(gc_block.words,bit(WORD_L));
+             break;
+        case 'P':
+             gc_block.p = value;
+             bit_true(gc_block.words,bit(WORD_P));
+             break;
+        case 'Q':
+             gc_block.q = value;
+             bit_true(gc_block.words,bit(WORD_Q));
+             break;
+        case 'S':
+             if(value < 0.0f)
+                return 0;
+             gc_block.s = value;
+             bit_true(gc_block.words,bit(WORD_S));
+             break;
+        default:
+             return 0;
+     }
+  }
+
+  //words the codes given need
+  if(((non_modal == 40) || (path_mode == 64)) &&
+     bit_isfalse(gc_block.words,bit(WORD_P)))
+     return 0;
+  if((non_modal == 100) && (bit_isfalse(gc_block.words,bit(WORD_L)) ||
+                            bit_isfalse(gc_block.words,bit(WORD_P))))
+     return 0;
+  if((tool == 43) && (bit_isfalse(gc_block.words,bit(WORD_H)) ||
+                      (gc_block.h < 0) || (gc_block.h >= N_TOOL)))
+     return 0;
+  switch(plane){
+     case 17:  axis_0 = X_AXIS; axis_1 = Y_AXIS; break;
+     case 18:  axis_0 = Z_AXIS; axis_1 = X_AXIS; break;
+     case 19:  axis_0 = Y_AXIS; axis_1 = Z_AXIS; break;
+     default:  axis_0 = gc.plane_axis_0; axis_1 = gc.plane_axis_1; break;
+  }
+  if(motion_mode < 0)
+     motion_mode = gc.motion_mode;
+  move = gc_block.axis_words && (non_modal != 100) && (non_modal != 280) &&
+         (non_modal != 300) && (non_modal != 920);
+  //G7 moves with its own pixels in place of the motion mode
+  if((raster != (gc_block.data != NULL)) || (raster && !move))
+     return 0;
+  if(move && (raster || (motion_mode != MOTION_MODE_SEEK)) &&
+     bit_isfalse(gc_block.words,bit(WORD_F)) && (gc.feed_rate <= 0.0f))
+     return 0;
+  if(move && !raster){
+     //the centre is I J K, one for each of X Y Z
+     if(((motion_mode == MOTION_MODE_CW_ARC) ||
+         (motion_mode == MOTION_MODE_CCW_ARC)) &&
+        (gc_block.ijk[axis_0] == 0.0f) && (gc_block.ijk[axis_1] == 0.0f))
+        return 0;
+     //G5 is in the XY plane with every control point word given
+     if((motion_mode == MOTION_MODE_SPLINE) && ((axis_0 != X_AXIS) ||
+        ((gc_block.words & WORDS_SPLINE) != WORDS_SPLINE)))
+        return 0;
+  }
+
+  //run it
+  if(bit_istrue(gc_block.words,bit(WORD_F)))
+     gc.feed_rate = gc_block.f;
+  //an S with an M3/M4 goes out with it as one spindle change
+  if(spindle >= 0){
+     if(bit_istrue(gc_block.words,bit(WORD_S)))
+        gc.spindle_speed = gc_block.s;
+     Modal_Group_Actions7(spindle);
+  }else if(bit_istrue(gc_block.words,bit(WORD_S)) && !raster)
+     gc_set_spindle_speed(gc_block.s);
+  if(non_modal == 40){
+     Modal_Group_Actions0(non_modal);
+     non_modal = -1;
+  }
+  gc.plane_axis_0 = axis_0;
+  gc.plane_axis_1 = axis_1;
+  if(tool >= 0)
+     gc_set_tool_offset((tool == 43)? gc_block.h : 0);
+  if(coord_select >= 0)
+     Modal_Group_Actions12(coord_select);
+  if(path_mode >= 0)
+     mc_set_path_blending((path_mode == 64)? gc_block.p : 0.0f);
+  if(distance >= 0)
+     gc.absolute_mode = (distance == 90);
+  gc.motion_mode = motion_mode;
+  if((non_modal >= 0) && !Modal_Group_Actions0(non_modal))
+     return 0;
+
+  if(move){
+     memcpy(target,gc.position,sizeof(target));
+     if(!gc_block.absolute_override)
+        gc_machine_to_work(target);
+     for(i = 0; i < N_AXIS; i++){
+        if(bit_isfalse(gc_block.axis_words,bit(i)))
+           continue;
+        if(gc.absolute_mode || gc_block.absolute_override)
+           target[i] = gc_block.xyz[i];
+        else
+           target[i] += gc_block.xyz[i];
+     }
+     gc_work_to_machine(target);
+     if(!raster)
+        gc_move(target);
+     else{
+        rpm = gc.spindle_speed;
+        if(bit_istrue(gc_block.words,bit(WORD_S)))
+           rpm = gc_block.s;
+        if(!raster_line(gc.position,target,gc.feed_rate,rpm,gc_block.data))
+           return 0;
+        memcpy(gc.position,target,sizeof(gc.position));
+     }
+  }
+
+  if(stop >= 0)
+     return Modal_Group_Actions4(stop);
+  return 1;
+}
+
+/* A $J= jog, axis words only, each a distance in mm from where the
+ * machine is whatever G90/G91 and the offsets are. It runs as a G0
+ * does. Returns 0 for any other word or an axis given twice.
+ */
+int gc_execute_jog(char *line){
+float target[N_AXIS],value;
+int char_counter,axis_words,i;
+char letter;
+  memcpy(target,gc.position,sizeof(target));
+  axis_words = 0;
+  char_counter = 0;
+  while(1){
+     letter = line[char_counter];
+     if(letter == 0)
+        break;
+     if((letter == ' ') || (letter == '\t') || (letter == '\r')){
+        char_counter++;
+        continue;
+     }
+     if((letter >= 'a') && (letter <= 'z'))
+        letter -= 'a' - 'A';
+     if(letter == 'A')
+        i = A_AXIS;
+     else if((letter >= 'X') && (letter <= 'Z'))
+        i = letter - 'X';
+     else
+        return 0;
+     char_counter++;
+     if(bit_istrue(axis_words,bit(i)) ||
+        !read_float(line,&char_counter,&value))
+        return 0;
+     target[i] += value;
+     bit_true(axis_words,bit(i));
+  }
+  if(!axis_words)
+     return 0;
+  gc_rapid(target);
+  memcpy(gc.position,target,sizeof(target));
+  return 1;
+}
@@ -0,0 +1,106 @@
+#ifndef GCODE_H
+#define GCODE_H
+
+#include "Config.h"
+#include "built_in.h"
+
+////////////////////////////////////////////////////
+//DEFINES
+//set by M2 and M30, the sender stops at the end of the program
+#define PROGRAM_FLOW_RUNNING   0
+#define PROGRAM_FLOW_COMPLETED 1
+//feed for the G0, G28 and G30 moves when they go through the planner,
+//the axis max rates limit it
+#define RAPID_FEED_RATE 1.0E6f // mm/min
+
+//motion modes, the G number
+#define MOTION_MODE_SEEK    0 // G0
+#define MOTION_MODE_LINEAR  1 // G1
+#define MOTION_MODE_CW_ARC  2 // G2
+#define MOTION_MODE_CCW_ARC 3 // G3
+#define MOTION_MODE_SPLINE  5 // G5
+
+//words other than axis words, bit() of these is set in
+//gc_block.words for each one given in a block
+#define WORD_F 0
+#define WORD_H 1
+#define WORD_I 2
+#define WORD_J 3
+#define WORD_K 4
+#define WORD_L 5
+#define WORD_P 6
+#define WORD_Q 7
+#define WORD_S 8
+#define WORDS_SPLINE (bit(WORD_I)|bit(WORD_J)|bit(WORD_P)|bit(WORD_Q))
+
+////////////////////////////////////////////////////
+//STRUCTS and ENUMS
+//modal state kept between blocks, offsets are in mm. work_offset
+//is the sum of the selected G54..G59 offset, G92 and the G43 tool
+//length on Z, rebuilt whenever one of them changes so a work
+//position is taken to machine with one add per axis. G92 is kept
+//here and not in flash, it is cleared at power up as in grbl
+typedef struct{
+ int motion_mode;              // MOTION_MODE_SEEK..SPLINE
+ int plane_axis_0;             // G17 X Y, G18 Z X, G19 Y Z
+ int plane_axis_1;
+ char absolute_mode;           // G90 1, G91 0
+ float feed_rate;              // F word in mm/min
+ float position[N_AXIS];       // end of the last block, machine coords
+ int coord_select;             // 0..5 for G54..G59
+ int tool_select;              // tool length in use, 0 is G49
+ float work_offset[N_AXIS];    // machine = work + work_offset
+ float g92_offset[N_AXIS];     // G92, RAM only
+ char program_flow;            // PROGRAM_FLOW_RUNNING or COMPLETED
+ char optional_stop;           // M1 only stops when this is set
+ char spindle;                 // SPINDLE_OFF, CW or CCW
+ float spindle_speed;          // S word in rpm
+}Gcode_State;
+
+//words of the block being run, filled in by the parser before the
+//group actions are called, axis words are in work coords
+typedef struct{
+ float xyz[N_AXIS];
+ float ijk[N_AXIS];            // G2/G3 centre, G5 I J, from the start
+ float f;
+ float p;                      // G4 secs, G10 coord or tool, G5, G64
+ float q;                      // G5
+ float s;
+ int   h;                      // G43 tool
+ int   l;                      // G10 L
+ char  *data;                  // G7 D, base64 to the end of the line
+ unsigned char axis_words;     // bit(axis) set for each axis given
+ unsigned int words;           // bit(WORD_x) set for each word given
+ char  absolute_override;      // G53, axis words are machine coords
+}Gcode_Block;
+
+extern Gcode_State gc;
+extern Gcode_Block gc_block;
+
+////////////////////////////////////////////////////
+//function prototypes
+void gc_init();
+int  gc_execute_line(char *line);
+int  gc_execute_jog(char *line);
+int  gc_set_coord_data(int coord_select,float *offset);
+void gc_set_g92(float *work_position);
+void gc_clear_g92();
+int  gc_set_tool_offset(int tool);
+int  gc_set_tool_length(int tool,float length);
+void gc_work_to_machine(float *target);
+void gc_machine_to_work(float *position);
+void gc_set_spindle_speed(float rpm);
+
+//[G4,G10,G28,G30,G53,G92,G92.1] Non-modal
+int Modal_Group_Actions0(int action);
+
+//[M0,M1,M2,M30] Stopping
+int Modal_Group_Actions4(int action);
+
+//[M3,M4,M5] Spindle turning
+int Modal_Group_Actions7(int action);
+
+//[G54...] Coordinate system selection
+int Modal_Group_Actions12(int action);
+
+#endif
@@ -0,0 +1,638 @@
+#include "Motion.h"
+
+
+#ifdef ARC_FIT
+//lines held back while they stay on one circle, point[0] is where
+//the planner ends and point[1..n] are the held line end points
+static struct{
+ float point[ARC_FIT_MAX_POINTS+1][N_AXIS];
+ float center[2];         // XY centre of the last good fit
+ float radius;
+ float sweep;             // radians, always positive
+ float feed_rate;
+ int   n;
+ char  fitted;            // point[0..n] fit the circle above
+ char  is_clockwise;
+}fit;
+#endif
+
+#ifdef PATH_BLENDING
+//end of the last line is held back until the next line shows
+//how to round off the corner
+static struct{
+ float vertex[N_AXIS];    // corner at the end of the held line
+ float unit_vec[N_AXIS];  // direction of the held line
+ float feed_rate;
+ float tolerance;         // G64 P, 0 for the exact path
+ char  active;
+}blend;
+#endif
+
+/////////////////////////////////////////////////////
+//run the stepper until the planner has room for another block
+static void mc_wait_for_room(){
+  while(plan_check_full_buffer()){
+     st_prep_buffer();
+     st_wake_up();
+  }
+}
+
+//queue a line once the planner has room
+static void mc_plan_line(float *target,float feed_rate){
+  mc_wait_for_room();
+  plan_buffer_line(target,feed_rate);
+}
+
+/* Queue a line, rounding off the corner with the line before when
+ * G64 P is set. The blend is a quintic Bezier with its first three
+ * control points on the incoming line and the last three on the
+ * outgoing one at V-d*uA, V-d/2*uA, V, V, V+d/2*uB, V+d*uB. That
+ * keeps the curvature zero where it meets the lines, and its middle
+ * is 7*d*sin(a/2)/32 from the corner for a turn of a, so d is sized
+ * from the tolerance and limited to the rest of the incoming line
+ * and half of the outgoing one. The curve is queued as chords that
+ * each turn no more than BLEND_ANGLE_PER_CHORD.
+ */
+static void mc_queue_line(float *target,float feed_rate){
+#ifdef PATH_BLENDING
+float position[N_AXIS],unit_vec[N_AXIS],point[N_AXIS];
+float length,length_in,cos_a,angle,d,t,u,w_in,w_out;
+int i,k,n;
+  if(blend.tolerance <= 0.0f){
+     mc_plan_line(target,feed_rate);
+     return;
+  }
+  plan_get_position(position);
+  if(!blend.active)
+     memcpy(blend.vertex,position,sizeof(position));
+  length = 0.0f;
+  for(i = 0; i < N_AXIS; i++){
+     unit_vec[i] = target[i] - blend.vertex[i];
+     length += unit_vec[i] * unit_vec[i];
+  }
+  if(length == 0.0f)
+     return;
+  length = f_sqrt(length);
+  for(i = 0; i < N_AXIS; i++)
+     unit_vec[i] /= length;
+
+  if(blend.active){
+     length_in = 0.0f;
+     cos_a = 0.0f;
+     for(i = 0; i < N_AXIS; i++){
+        d = blend.vertex[i] - position[i];
+        length_in += d * d;
+        cos_a += blend.unit_vec[i] * unit_vec[i];
+     }
+     length_in = f_sqrt(length_in);
+     cos_a = max(-1.0f,min(1.0f,cos_a));
+     angle = f_atan2(f_sqrt(1.0f - cos_a * cos_a),cos_a);
+     //reversals and near straight joins run through the corner
+     if((feed_rate == blend.feed_rate) && (length_in > 0.0f) &&
+        (angle >= BLEND_ANGLE_PER_CHORD) && (angle < M_Pi - BLEND_ANGLE_PER_CHORD)){
+        d = 32.0f * blend.tolerance / (7.0f * f_sin(0.5f * angle));
+        d = min(d,length_in);
+        d = min(d,0.5f * length);
+        if(d < length_in){
+           for(i = 0; i < N_AXIS; i++)
+              point[i] = blend.vertex[i] - d * blend.unit_vec[i];
+           mc_plan_line(point,feed_rate);
+        }
+        n = (int)f_ceil(angle / BLEND_ANGLE_PER_CHORD);
+        if(n > BLEND_MAX_CHORDS)
+           n = BLEND_MAX_CHORDS;
+        for(k = 1; k <= n; k++){
+           t = (float)k / n;
+           u = 1.0f - t;
+           w_in  = d * u * u * u * u * (u + 2.5f * t);
+           w_out = d * t * t * t * t * (t + 2.5f * u);
+           for(i = 0; i < N_AXIS; i++)
+              point[i] = blend.vertex[i] - w_in * blend.unit_vec[i] + w_out * unit_vec[i];
+           mc_plan_line(point,feed_rate);
+        }
+     }else{
+        mc_plan_line(blend.vertex,blend.feed_rate);
+     }
+  }
+  memcpy(blend.vertex,target,sizeof(blend.vertex));
+  memcpy(blend.unit_vec,unit_vec,sizeof(unit_vec));
+  blend.feed_rate = feed_rate;
+  blend.active = 1;
+#else
+  mc_plan_line(target,feed_rate);
+#endif
+}
+
+//end of everything queued or held back, in mm
+static void mc_get_position(float *position){
+#ifdef PATH_BLENDING
+  if(blend.active){
+     memcpy(position,blend.vertex,sizeof(blend.vertex));
+     return;
+  }
+#endif
+  plan_get_position(position);
+}
+
+static void mc_arc_chords(float *target,float *offset,float radius,float feed_rate,
+                          int is_clockwise,int axis_0,int axis_1,float tolerance);
+
+#ifdef ARC_FIT
+/* Fit a circle through the first, middle and last held points, then
+ * check every held point is on it and the middle of every line does
+ * not cut inside it by more than ARC_FIT_TOLERANCE, and that the
+ * lines all turn the same way. Returns 1 and keeps the circle if the
+ * whole run fits.
+ */
+static int arc_fit_test(){
+float b0,b1,c0,c1,bb,cc,d,u0,u1,radius,center0,center1;
+float p0,p1,q0,q1,m0,m1,cross,sweep;
+int i,m;
+  m  = fit.n >> 1;
+  b0 = fit.point[m][X_AXIS] - fit.point[0][X_AXIS];
+  b1 = fit.point[m][Y_AXIS] - fit.point[0][Y_AXIS];
+  c0 = fit.point[fit.n][X_AXIS] - fit.point[0][X_AXIS];
+  c1 = fit.point[fit.n][Y_AXIS] - fit.point[0][Y_AXIS];
+  //d is +ve for a counter clockwise run, 0 for a straight one
+  d  = 2.0f * (b0 * c1 - b1 * c0);
+  if(f_fabs(d) < 1E-9f)
+     return 0;
+  bb = b0 * b0 + b1 * b1;
+  cc = c0 * c0 + c1 * c1;
+  u0 = (c1 * bb - b1 * cc) / d;
+  u1 = (b0 * cc - c0 * bb) / d;
+  radius = f_sqrt(u0 * u0 + u1 * u1);
+  if(radius > ARC_FIT_MAX_RADIUS)
+     return 0;
+  center0 = fit.point[0][X_AXIS] + u0;
+  center1 = fit.point[0][Y_AXIS] + u1;
+
+  sweep = 0.0f;
+  p0 = -u0;
+  p1 = -u1;
+  for(i = 1; i <= fit.n; i++){
+     q0 = fit.point[i][X_AXIS] - center0;
+     q1 = fit.point[i][Y_AXIS] - center1;
+     if(f_fabs(f_sqrt(q0 * q0 + q1 * q1) - radius) > ARC_FIT_TOLERANCE)
+        return 0;
+     m0 = 0.5f * (p0 + q0);
+     m1 = 0.5f * (p1 + q1);
+     if(radius - f_sqrt(m0 * m0 + m1 * m1) > ARC_FIT_TOLERANCE)
+        return 0;
+     cross = p0 * q1 - p1 * q0;
+     if((cross > 0.0f) != (d > 0.0f))
+        return 0;
+     sweep += f_atan2(f_fabs(cross),p0 * q0 + p1 * q1);
+     p0 = q0;
+     p1 = q1;
+  }
+  //leave full circles to the lines, the arc end would be ambiguous
+  if(sweep > 2.0f * M_Pi - 0.01f)
+     return 0;
+
+  fit.center[0] = center0;
+  fit.center[1] = center1;
+  fit.radius = radius;
+  fit.sweep = sweep;
+  fit.is_clockwise = (d < 0.0f);
+  return 1;
+}
+
+/* Queue the held run as one arc, or as the lines it came from when
+ * the arc would not need fewer chords than that. The arc is chorded
+ * to ARC_FIT_TOLERANCE, the same as the fit was accepted at, a
+ * tighter chord would mostly give more chords than the lines.
+ */
+static void arc_fit_emit(){
+float target[N_AXIS],offset[N_AXIS];
+unsigned int segments;
+int i,n;
+  n = fit.n;
+  fit.n = 0;
+  fit.fitted = 0;
+  segments = f_floor(0.5f * fit.sweep * fit.radius /
+                     f_sqrt(ARC_FIT_TOLERANCE * (2.0f * fit.radius - ARC_FIT_TOLERANCE)));
+  if(segments + 1 >= n){
+     for(i = 1; i <= n; i++)
+        mc_queue_line(fit.point[i],fit.feed_rate);
+     return;
+  }
+  memcpy(target,fit.point[n],sizeof(target));
+  clear_vector(offset);
+  offset[X_AXIS] = fit.center[0] - fit.point[0][X_AXIS];
+  offset[Y_AXIS] = fit.center[1] - fit.point[0][Y_AXIS];
+  mc_arc_chords(target,offset,fit.radius,fit.feed_rate,fit.is_clockwise,X_AXIS,Y_AXIS,ARC_FIT_TOLERANCE);
+}
+
+//queue the held run as it stands
+static void arc_fit_flush(){
+int i,n;
+  if(fit.n == 0)
+     return;
+  if(fit.fitted){
+     arc_fit_emit();
+     return;
+  }
+  n = fit.n;
+  fit.n = 0;
+  for(i = 1; i <= n; i++)
+     mc_queue_line(fit.point[i],fit.feed_rate);
+}
+#endif
+
+/* Linear move to target in mm at feed_rate in mm/min. With ARC_FIT
+ * short XY lines are held back until the run stops fitting a circle,
+ * call mc_flush() once no more lines are coming.
+ */
+void mc_line(float *target,float feed_rate){
+#ifdef ARC_FIT
+float *last,d0,d1;
+  if(fit.n && ((feed_rate != fit.feed_rate) || (fit.n == ARC_FIT_MAX_POINTS)))
+     arc_fit_flush();
+  if(fit.n == 0)
+     mc_get_position(fit.point[0]);
+
+  //only lines in the XY plane at the same height are fitted
+  last = fit.point[fit.n];
+  d0 = target[X_AXIS] - last[X_AXIS];
+  d1 = target[Y_AXIS] - last[Y_AXIS];
+  if((target[Z_AXIS] != fit.point[0][Z_AXIS]) || (target[A_AXIS] != fit.point[0][A_AXIS]) ||
+     (d0 * d0 + d1 * d1 > ARC_FIT_MAX_SEGMENT * ARC_FIT_MAX_SEGMENT) ||
+     ((d0 == 0.0f) && (d1 == 0.0f))){
+     arc_fit_flush();
+     mc_queue_line(target,feed_rate);
+     return;
+  }
+
+  fit.feed_rate = feed_rate;
+  fit.n++;
+  memcpy(fit.point[fit.n],target,sizeof(fit.point[0]));
+  if(fit.n < ARC_FIT_MIN_POINTS)
+     return;
+  if(arc_fit_test()){
+     fit.fitted = 1;
+     return;
+  }
+
+  //the new line breaks the run, it starts the next one
+  fit.n--;
+  if(fit.fitted){
+     arc_fit_emit();
+     mc_get_position(fit.point[0]);
+     memcpy(fit.point[1],target,sizeof(fit.point[0]));
+     fit.n = 1;
+  }else{
+     //never fitted, let the oldest line go and slide the run on
+     mc_queue_line(fit.point[1],fit.feed_rate);
+     memmove(fit.point[0],fit.point[1],(fit.n + 1) * sizeof(fit.point[0]));
+  }
+#else
+  mc_queue_line(target,feed_rate);
+#endif
+}
+
+/* Arc from the current position to target around the centre at
+ * offset from the start, in the axis_0/axis_1 plane. The other axes
+ * move linearly for a helix. The arc is cut into chords within
+ * ARC_TOLERANCE.
+ */
+void mc_arc(float *target,float *offset,float radius,float feed_rate,
+            int is_clockwise,int axis_0,int axis_1){
+#ifdef ARC_FIT
+  arc_fit_flush();
+#endif
+  mc_arc_chords(target,offset,radius,feed_rate,is_clockwise,axis_0,axis_1,ARC_TOLERANCE);
+}
+
+/* Chords within tolerance of the arc, using a small angle rotation
+ * corrected with an exact sin/cos every N_ARC_CORRECTION chords.
+ */
+static void mc_arc_chords(float *target,float *offset,float radius,float feed_rate,
+                          int is_clockwise,int axis_0,int axis_1,float tolerance){
+float position[N_AXIS],linear_per_segment[N_AXIS];
+float center_axis0,center_axis1,r_axis0,r_axis1,rt_axis0,rt_axis1;
+float angular_travel,theta_per_segment,cos_T,sin_T,cos_Ti,sin_Ti,r_axisi;
+unsigned int segments,i;
+int count,n;
+
+  mc_get_position(position);
+  center_axis0 = position[axis_0] + offset[axis_0];
+  center_axis1 = position[axis_1] + offset[axis_1];
+  r_axis0  = -offset[axis_0];
+  r_axis1  = -offset[axis_1];
+  rt_axis0 = target[axis_0] - center_axis0;
+  rt_axis1 = target[axis_1] - center_axis1;
+
+  angular_travel = f_atan2(r_axis0 * rt_axis1 - r_axis1 * rt_axis0,
+                         r_axis0 * rt_axis0 + r_axis1 * rt_axis1);
+  if(is_clockwise){
+     if(angular_travel >= -ARC_ANGULAR_TRAVEL_EPSILON)
+        angular_travel -= 2.0f * M_Pi;
+  }else{
+     if(angular_travel <= ARC_ANGULAR_TRAVEL_EPSILON)
+        angular_travel += 2.0f * M_Pi;
+  }
+
+  segments = f_floor(f_fabs(0.5f * angular_travel * radius) /
+                     f_sqrt(tolerance * (2.0f * radius - tolerance)));
+  if(segments){
+     theta_per_segment = angular_travel / segments;
+     for(n = 0; n < N_AXIS; n++)
+        linear_per_segment[n] = (target[n] - position[n]) / segments;
+
+     //small angle approximation of the rotation per chord
+     cos_T = 2.0f - theta_per_segment * theta_per_segment;
+     sin_T = theta_per_segment * 0.16666667f * (cos_T + 4.0f);
+     cos_T *= 0.5f;
+
+     count = 0;
+     for(i = 1; i < segments; i++){
+        if(count < N_ARC_CORRECTION){
+           r_axisi = r_axis0 * sin_T + r_axis1 * cos_T;
+           r_axis0 = r_axis0 * cos_T - r_axis1 * sin_T;
+           r_axis1 = r_axisi;
+           count++;
+        }else{
+           cos_Ti = f_cos(i * theta_per_segment);
+           sin_Ti = f_sin(i * theta_per_segment);
+           r_axis0 = -offset[axis_0] * cos_Ti + offset[axis_1] * sin_Ti;
+           r_axis1 = -offset[axis_0] * sin_Ti - offset[axis_1] * cos_Ti;
+           count = 0;
+        }
+        for(n = 0; n < N_AXIS; n++)
+           position[n] += linear_per_segment[n];
+        position[axis_0] = center_axis0 + r_axis0;
+        position[axis_1] = center_axis1 + r_axis1;
+        mc_queue_line(position,feed_rate);
+     }
+  }
+  mc_queue_line(target,feed_rate);
+}
+
+/* Sag of the next chord times 8, taken as the part of the second
+ * difference across the first, a straight run has none however
+ * unevenly t is spread along it.
+ */
+static float spline_sag(float *d1,float *d2){
+float length;
+  length = f_sqrt(d1[0] * d1[0] + d1[1] * d1[1]);
+  if(length < 1E-9f)
+     return f_sqrt(d2[0] * d2[0] + d2[1] * d2[1]);
+  return f_fabs(d1[0] * d2[1] - d1[1] * d2[0]) / length;
+}
+
+//sag of the chord after next as well, the curve can bend harder there
+static float spline_err(float *d1,float *d2,float *d3){
+float n1[2],n2[2];
+  n1[0] = d1[0] + d2[0];
+  n1[1] = d1[1] + d2[1];
+  n2[0] = d2[0] + d3[0];
+  n2[1] = d2[1] + d3[1];
+  return max(spline_sag(d1,d2),spline_sag(n1,n2));
+}
+
+/* G5 cubic Bezier in the XY plane from the current position to
+ * target, offset_1 is I J from the start to the first control point
+ * and offset_2 is P Q from target to the second. Other axes move
+ * linearly with t. The curve is walked by adaptive forward
+ * differencing with the differences kept for a step h in t:
+ *   halve   d3 = d3/8, d2 = d2/4 - d3, d1 = (d1 - d2)/2
+ *   double  d1 = 2d1 + d2, d2 = 4d2 + 4d3, d3 = 8d3
+ * The step is halved until each chord sags less than
+ * SPLINE_TOLERANCE and doubled while the doubled chord would sag
+ * less than half of it. The curve reaches the planner as chords,
+ * not as a curve the step pipeline runs, one block per chord: a
+ * quarter circle like curve 20 mm across is 64 blocks, 100 mm
+ * across is 256.
+ */
+void mc_spline(float *target,float *offset_1,float *offset_2,float feed_rate){
+float start[N_AXIS],position[N_AXIS];
+float a[2],b[2],c[2],d1[2],d2[2],d3[2],e1[2],e2[2],e3[2],p[2];
+float h,p0,p1,p2,p3;
+unsigned long t,step,one;
+int i,n;
+
+#ifdef ARC_FIT
+  arc_fit_flush();
+#endif
+  mc_get_position(start);
+  memcpy(position,start,sizeof(start));
+  for(i = 0; i < 2; i++){
+     p0 = start[X_AXIS+i];
+     p1 = p0 + offset_1[X_AXIS+i];
+     p3 = target[X_AXIS+i];
+     p2 = p3 + offset_2[X_AXIS+i];
+     a[i] = 3.0f * (p1 - p2) + p3 - p0;
+     b[i] = 3.0f * (p0 - 2.0f * p1 + p2);
+     c[i] = 3.0f * (p1 - p0);
+     p[i] = p0;
+  }
+
+  one  = 1UL << SPLINE_MAX_LEVEL;
+  step = 1UL << (SPLINE_MAX_LEVEL - SPLINE_START_LEVEL);
+  h = 1.0f / (1UL << SPLINE_START_LEVEL);
+  for(i = 0; i < 2; i++){
+     d3[i] = 6.0f * a[i] * h * h * h;
+     d2[i] = d3[i] + 2.0f * b[i] * h * h;
+     d1[i] = (a[i] * h + b[i]) * h * h + c[i] * h;
+  }
+
+  t = 0;
+  while(1){
+     while((step > 1) && (spline_err(d1,d2,d3) > 8.0f * SPLINE_TOLERANCE)){
+        for(i = 0; i < 2; i++){
+           d3[i] *= 0.125f;
+           d2[i] = 0.25f * d2[i] - d3[i];
+           d1[i] = 0.5f * (d1[i] - d2[i]);
+        }
+        step >>= 1;
+     }
+     //only double on a boundary of the bigger step with room left
+     while(((t & ((step << 1) - 1)) == 0) && (t + (step << 1) <= one)){
+        for(i = 0; i < 2; i++){
+           e1[i] = 2.0f * d1[i] + d2[i];
+           e2[i] = 4.0f * (d2[i] + d3[i]);
+           e3[i] = 8.0f * d3[i];
+        }
+        if(spline_err(e1,e2,e3) > 4.0f * SPLINE_TOLERANCE)
+           break;
+        memcpy(d1,e1,sizeof(d1));
+        memcpy(d2,e2,sizeof(d2));
+        memcpy(d3,e3,sizeof(d3));
+        step <<= 1;
+     }
+
+     for(i = 0; i < 2; i++){
+        p[i]  += d1[i];
+        d1[i] += d2[i];
+        d2[i] += d3[i];
+     }
+     t += step;
+     if(t >= one)
+        break;
+     for(n = 0; n < N_AXIS; n++)
+        position[n] = start[n] + (target[n] - start[n]) * ((float)t / one);
+     position[X_AXIS] = p[0];
+     position[Y_AXIS] = p[1];
+     mc_queue_line(position,feed_rate);
+  }
+  mc_queue_line(target,feed_rate);
+}
+
+//queue anything held back for fitting or blending, call once
+//input goes quiet
+void mc_flush(){
+#ifdef ARC_FIT
+  arc_fit_flush();
+#endif
+#ifdef PATH_BLENDING
+  if(blend.active){
+     blend.active = 0;
+     mc_plan_line(blend.vertex,blend.feed_rate);
+  }
+#endif
+}
+
+/* Run the queue out before something that stalls the cpu, such as
+ * a flash write, so the segment buffer cannot run dry mid move.
+ * plan_get_current_block() also lets go of a move the planner holds
+ * back for merging. Held at an M0 the steppers are already stopped,
+ * so it returns there rather than wait for cycle start.
+ */
+void mc_synchronize(){
+  mc_flush();
+  while((plan_get_current_block() != NULL) || st_is_busy()){
+     if(st_is_held())
+        return;
+     st_prep_buffer();
+     st_wake_up();
+  }
+}
+
+#ifdef INDEPENDENT_RAPIDS
+/* G0 on the axis generators, the queue is run out first and this
+ * waits for every axis to stop, the planner then carries on from
+ * there. Returns 0 without moving while held at an M0, the rapid is
+ * queued as a line then.
+ */
+int mc_rapid(float *target){
+  mc_synchronize();
+  if(!Axis_Rapid(target))
+     return 0;
+  while(!Axis_Release());
+  return 1;
+}
+#endif
+
+/* G4 dwell, or an M0 hold with DWELL_HOLD, queued behind the lines
+ * before it. Nothing waits here, the input keeps filling the queue
+ * while the dwell runs and the move after it starts from the isr.
+ */
+void mc_dwell(float seconds){
+  mc_flush();
+  mc_wait_for_room();
+  plan_buffer_dwell(seconds);
+}
+
+/* M3, M4, M5 and S changes, queued with the moves so the spindle
+ * changes as the next block starts and the path does not stop for
+ * it. With SPINDLE_SPINUP_DELAY a dwell is queued after the spindle
+ * is turned on or reversed, a laser needs no time to spin up.
+ */
+void mc_spindle(int state,float rpm){
+#ifdef SPINDLE_SPINUP_DELAY
+int last_state;
+#endif
+unsigned int duty;
+  mc_flush();
+  mc_wait_for_room();
+  duty = (state == SPINDLE_OFF)? 0 : spindle_get_duty(rpm);
+#ifdef SPINDLE_SPINUP_DELAY
+  last_state = plan_get_spindle_state();
+  plan_set_spindle(state,duty);
+  if((state != SPINDLE_OFF) && (state != last_state) && !LASER_MODE)
+     mc_dwell(SPINDLE_SPINUP_DELAY);
+#else
+  plan_set_spindle(state,duty);
+#endif
+}
+
+/* G7 scan line from start to target, its pixels are in the raster
+ * slot. start is where the program put the last block, the queue
+ * ends past it at the last lead out. The line is queued on its own
+ * with no fitting, blending or merging so each pixel lands on its
+ * step, between a lead in and a lead out of RASTER_OVERSCAN times
+ * the distance needed to reach feed_rate, with the laser off. The
+ * lead in starts with a reversal so the path is at rest there and
+ * the whole scan runs at feed_rate. Returns 0 with nothing queued
+ * for a line that moves no axis a step, no block would carry the
+ * slot then.
+ */
+int mc_raster(float *start,float *target,float feed_rate,float rpm,int slot){
+float point[N_AXIS],unit_vec[N_AXIS];
+float length,speed,accel,overscan,u;
+unsigned int duty;
+int state,i;
+  for(i = 0; i < N_AXIS; i++){
+     if(plan_mm_to_steps(target[i],i) != plan_mm_to_steps(start[i],i))
+        break;
+  }
+  if(i == N_AXIS)
+     return 0;
+  mc_flush();
+  length = 0.0f;
+  for(i = 0; i < N_AXIS; i++){
+     unit_vec[i] = target[i] - start[i];
+     length += unit_vec[i] * unit_vec[i];
+  }
+  length = f_sqrt(length);
+
+  //speed and acceleration along the line as the planner limits them
+  speed = feed_rate;
+  accel = 1.0E9f;
+  for(i = 0; i < N_AXIS; i++){
+     unit_vec[i] /= length;
+     u = f_fabs(unit_vec[i]);
+     if(u > 0.0f){
+        speed = min(speed,plan_get_max_rate(i) / u);
+        accel = min(accel,plan_get_acceleration(i) / u);
+     }
+  }
+  speed /= 60.0f;
+  overscan = RASTER_OVERSCAN * speed * speed / (2.0f * accel);
+
+  state = plan_get_spindle_state();
+  duty = plan_get_spindle_duty();
+  mc_wait_for_room();
+  plan_set_spindle(state,0);
+  for(i = 0; i < N_AXIS; i++)
+     point[i] = start[i] - overscan * unit_vec[i];
+  mc_plan_line(point,feed_rate);
+  mc_plan_line(start,feed_rate);
+
+  mc_wait_for_room();
+  plan_set_spindle(state,spindle_get_duty(rpm));
+  plan_set_raster(slot);
+  mc_plan_line(target,feed_rate);
+
+  mc_wait_for_room();
+  plan_set_raster(RASTER_NONE);
+  plan_set_spindle(state,0);
+  for(i = 0; i < N_AXIS; i++)
+     point[i] = target[i] + overscan * unit_vec[i];
+  mc_plan_line(point,feed_rate);
+
+  mc_wait_for_room();
+  plan_set_spindle(state,duty);
+  return 1;
+}
+
+/* G64 P sets the corner tolerance in mm, G61 sets 0 to run the
+ * exact path. Anything held back is queued first.
+ */
+void mc_set_path_blending(float tolerance){
+  mc_flush();
+#ifdef PATH_BLENDING
+  blend.tolerance = tolerance;
+#endif
+}
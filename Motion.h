@@ -0,0 +1,59 @@
+#ifndef MOTION_H
+#define MOTION_H
+
+#include "Config.h"
+#include "built_in.h"
+
+////////////////////////////////////////////////////
+//DEFINES
+//arcs are cut into chords that stay within this of the true arc
+#define ARC_TOLERANCE 0.002f // mm
+//exact sin/cos of the arc is recalculated every n chords
+#define N_ARC_CORRECTION 12
+#define ARC_ANGULAR_TRAVEL_EPSILON 5E-7f
+
+//runs of short lines in the XY plane that lie on one circle are
+//replaced with a single arc before the planner, comment out to
+//pass every line through as sent
+#define ARC_FIT
+#define ARC_FIT_TOLERANCE 0.005f // mm off the circle allowed
+#define ARC_FIT_MIN_POINTS 4    // lines needed before fitting
+#define ARC_FIT_MAX_POINTS 48   // lines held in one fitted arc
+#define ARC_FIT_MAX_SEGMENT 1.0f // mm, longer lines are not fitted
+#define ARC_FIT_MAX_RADIUS 500.0f// mm, flatter runs are left as lines
+
+//G64 P corners, sharp corners are rounded off with a curve that
+//stays within the P tolerance of the corner, comment out to always
+//run the exact path
+#define PATH_BLENDING
+#define BLEND_ANGLE_PER_CHORD 0.0873f // rad, 5 degrees per chord
+#define BLEND_MAX_CHORDS 24
+
+//G5 cubic splines are stepped by adaptive forward differencing,
+//the step in t is halved or doubled to keep each chord within
+//the tolerance of the curve
+#define SPLINE_TOLERANCE 0.002f // mm
+#define SPLINE_START_LEVEL 4   // first step is 1/16 of the curve
+#define SPLINE_MAX_LEVEL 16    // smallest step is 1/65536
+
+//G7 scan lines have a lead in and out with the laser off this many
+//times the distance needed to reach the feed rate
+#define RASTER_OVERSCAN 1.2f
+
+////////////////////////////////////////////////////
+//function prototypes
+void mc_line(float *target,float feed_rate);
+void mc_arc(float *target,float *offset,float radius,float feed_rate,
+            int is_clockwise,int axis_0,int axis_1);
+void mc_spline(float *target,float *offset_1,float *offset_2,float feed_rate);
+void mc_flush();
+void mc_synchronize();
+#ifdef INDEPENDENT_RAPIDS
+int  mc_rapid(float *target);
+#endif
+void mc_dwell(float seconds);
+void mc_spindle(int state,float rpm);
+int  mc_raster(float *start,float *target,float feed_rate,float rpm,int slot);
+void mc_set_path_blending(float tolerance);
+
+#endif
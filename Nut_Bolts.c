@@ -13,34 +13,317 @@ unsigned long ul_ = 0;
 
 //Convert a unsigned long back to a floating point from flash memory
 float ulong2flt(unsigned long ul_){
-float f_ = 0.0;
+float f_ = 0.0f;
  memcpy(&f_,&ul_,sizeof(unsigned long ));
  
 return f_;
 }
 
-//returns the specific decimal value (rounded value) of the given float
+//returns the given float rounded to 2 decimals
 float fround(float val){
-float value = (long)(val * 100.00 + 0.5);
-  return (float)(value / 100.00);
+  return (float)lround(val * 100.0f) / 100.0f;
 }
 
-//return the int val rounfed off to the nearest int
+//return the int val rounded off to the nearest int
 int round(float val){
-float temp = 0.00,tempC = 0.00,tempF = 0.00,dec = 0.00;
-  tempC = ceil(val);
-  tempF = floor(val);
-  dec = val - tempF;
-  temp = (dec > 0.5)? tempC : tempF;
-  return (int)temp;
+  return (int)lround(val);
 }
 
-//return the int val rounfed off to the nearest int
+/* Nearest long with halves away from zero. The cast truncates
+ * toward zero and the part cut off is exact in a float, so only
+ * that is compared against a half. Adding 0.5 before the cast
+ * would round 0.49999997 up and -2.5 the wrong way.
+ */
 long lround(float val){
-float temp = 0.00,tempC = 0.00,tempF = 0.00,dec = 0.00;
-  tempC = ceil(val);
-  tempF = floor(val);
-  dec = val - tempF;
-  temp = (dec > 0.5)? tempC : tempF;
-  return (long)temp;
-}
\ No newline at end of file
+long l;
+float dec;
+  l = (long)val;
+  dec = val - (float)l;
+  if(dec >= 0.5f)
+     l++;
+  else if(dec <= -0.5f)
+     l--;
+  return l;
+}
+
+//float to Q16.16 fixed point, rounded and held at the long range
+long flt2q16(float val){
+  if(val >= 32768.0f)
+     return 0x7FFFFFFF;
+  if(val <= -32768.0f)
+     return (long)0x80000000;
+  return lround(val * 65536.0f);
+}
+
+/* Product of two Q16.16 values as a whole number, a*b/2^32 rounded
+ * with halves away from 0. The 64 bit product is built from 16 bit
+ * halves so it is the same on any compiler without long long.
+ */
+long q16_mul_int(long a,long b){
+unsigned long ua,ub,p0,p1,p2,p3,mid,lo,hi;
+char neg;
+  neg = (a < 0) ^ (b < 0);
+  ua = (a < 0)? (unsigned long)(-a) : (unsigned long)a;
+  ub = (b < 0)? (unsigned long)(-b) : (unsigned long)b;
+  p0 = (ua & 0xFFFF) * (ub & 0xFFFF);
+  p1 = (ua & 0xFFFF) * (ub >> 16);
+  p2 = (ua >> 16) * (ub & 0xFFFF);
+  p3 = (ua >> 16) * (ub >> 16);
+  mid = (p0 >> 16) + (p1 & 0xFFFF) + (p2 & 0xFFFF);
+  lo  = (mid << 16) | (p0 & 0xFFFF);
+  hi  = p3 + (p1 >> 16) + (p2 >> 16) + (mid >> 16);
+  hi += lo >> 31;
+  return neg? -(long)hi : (long)hi;
+}
+
+/* Q16.16 to a decimal string with 0 to 4 decimals, halves away from 0,
+ * only integer maths. str needs room for 13 chars, returns the
+ * length written.
+ */
+int q16_to_str(long q,char *str,int decimals){
+const unsigned int scale[5] = {1,10,100,1000,10000};
+char digits[6];
+unsigned long u,ipart,fpart;
+int n,i;
+  if(decimals < 0)
+     decimals = 0;
+  if(decimals > 4)
+     decimals = 4;
+  u = (q < 0)? (unsigned long)(-q) : (unsigned long)q;
+  ipart = u >> 16;
+  fpart = ((u & 0xFFFF) * scale[decimals] + 0x8000) >> 16;
+  if(fpart >= scale[decimals]){
+     ipart++;
+     fpart -= scale[decimals];
+  }
+  //no sign on a value that rounds to 0
+  n = 0;
+  if((q < 0) && (ipart || fpart))
+     str[n++] = '-';
+
+  i = 0;
+  do{
+     digits[i++] = '0' + (ipart % 10);
+     ipart /= 10;
+  }while(ipart);
+  while(i)
+     str[n++] = digits[--i];
+  if(decimals){
+     str[n++] = '.';
+     for(i = decimals - 1; i >= 0; i--){
+        str[n + i] = '0' + (fpart % 10);
+        fpart /= 10;
+     }
+     n += decimals;
+  }
+  str[n] = 0;
+  return n;
+}
+
+/* The number at line[*char_counter] as grbl reads it, for G code
+ * words run together as in X10Y5 where atof would not say where the
+ * number ended. Digits past MAX_INT_DIGITS only scale the value, so
+ * the whole digits fit a long and one multiply or divide by an exact
+ * power of 10 places the point. char_counter is moved past the
+ * number, returns 0 if there are no digits.
+ */
+int read_float(char *line,int *char_counter,float *value){
+char *ptr;
+unsigned long intval;
+float scale;
+int exp,ndigit,isneg,isdecimal;
+char c;
+  ptr = line + *char_counter;
+  c = *ptr++;
+  isneg = 0;
+  if(c == '-'){
+     isneg = 1;
+     c = *ptr++;
+  }else if(c == '+')
+     c = *ptr++;
+
+  intval = 0;
+  exp = 0;
+  ndigit = 0;
+  isdecimal = 0;
+  while(1){
+     if((c >= '0') && (c <= '9')){
+        ndigit++;
+        if(ndigit <= MAX_INT_DIGITS){
+           if(isdecimal)
+              exp--;
+           intval = intval * 10 + (c - '0');
+        }else if(!isdecimal)
+           exp++;
+     }else if((c == '.') && !isdecimal)
+        isdecimal = 1;
+     else
+        break;
+     c = *ptr++;
+  }
+  if(ndigit == 0)
+     return 0;
+
+  scale = 1.0f;
+  *value = (float)intval;
+  if(exp < 0){
+     while(exp++ < 0)
+        scale *= 10.0f;
+     *value /= scale;
+  }else{
+     while(exp-- > 0)
+        scale *= 10.0f;
+     *value *= scale;
+  }
+  if(isneg)
+     *value = -*value;
+  *char_counter = ptr - line - 1;
+  return 1;
+}
+
+/* 1/sqrt(x) from the exponent halving seed and three Newton steps,
+ * good to the last bit or two of a float, x must be > 0.
+ */
+float f_rsqrt(float x){
+union{ float f; unsigned long u; }v;
+float half;
+  half = 0.5f * x;
+  v.f = x;
+  v.u = 0x5F375A86 - (v.u >> 1);
+  v.f = v.f * (1.5f - half * v.f * v.f);
+  v.f = v.f * (1.5f - half * v.f * v.f);
+  v.f = v.f * (1.5f - half * v.f * v.f);
+  return v.f;
+}
+
+float f_sqrt(float x){
+  if(x <= 0.0f)
+     return 0.0f;
+  return x * f_rsqrt(x);
+}
+
+//pi/2 split so the high part times a whole number of quarter turns
+//is exact in a float, the low part carries the rest
+#define PI_2_HI 1.5703125f
+#define PI_2_LO 4.8382679489661923e-4f
+
+/* sin(x + quarter * pi/2). x is taken to [-pi/4,pi/4] by whole
+ * quarter turns in two parts, so the turns add no more error than
+ * the low part's rounding for |x| up to about 1e4, then the Cephes
+ * sinf or cosf polynomial is picked by the quadrant.
+ */
+static float f_sin_quadrant(float x,int quarter){
+float y,z,r;
+long q;
+  q = (long)(x * (1.0f / M_Pi_2) + ((x < 0.0f)? -0.5f : 0.5f));
+  y = (x - (float)q * PI_2_HI) - (float)q * PI_2_LO;
+  q = (q + quarter) & 3;
+  z = y * y;
+  if(q & 1)
+     r = 1.0f - 0.5f * z + z * z * ((2.443315711809948e-5f * z -
+         1.388731625493765e-3f) * z + 4.166664568298827e-2f);
+  else
+     r = y + y * z * ((-1.9515295891e-4f * z + 8.3321608736e-3f) * z -
+         1.6666654611e-1f);
+  return (q & 2)? -r : r;
+}
+
+/* Error under 1e-7 for |x| <= 100 from the host check in
+ * tests/nuts_bolts_test.c.
+ */
+float f_sin(float x){
+  return f_sin_quadrant(x,0);
+}
+
+float f_cos(float x){
+  return f_sin_quadrant(x,1);
+}
+
+/* atan on [0,1] from the Abramowitz and Stegun 4.4.49 polynomial,
+ * error under 2e-7, the octant is put back from the signs and
+ * which of x or y is bigger.
+ */
+float f_atan2(float y,float x){
+float ax,ay,r,r2,a;
+  ax = f_fabs(x);
+  ay = f_fabs(y);
+  if((ax == 0.0f) && (ay == 0.0f))
+     return 0.0f;
+  r  = (ay > ax)? ax / ay : ay / ax;
+  r2 = r * r;
+  a  = r * (1.0f + r2 * (-0.3333314528f + r2 * (0.1999355085f + r2 * (-0.1420889944f +
+       r2 * (0.1065626393f + r2 * (-0.0752896400f + r2 * (0.0429096138f +
+       r2 * (-0.0161657367f + r2 * 0.0028662257f))))))));
+  if(ay > ax)
+     a = M_Pi_2 - a;
+  if(x < 0.0f)
+     a = M_Pi - a;
+  return (y < 0.0f)? -a : a;
+}
+
+//fabs, floor and ceil without the trip through double in libm
+float f_fabs(float x){
+  return (x < 0.0f)? -x : x;
+}
+
+/* The cast truncates toward zero so a negative fraction is one too
+ * high for floor and a positive one too low for ceil. From 2^23 up
+ * every float is whole and may not fit a long, it goes back as is.
+ */
+float f_floor(float x){
+long l;
+  if((x >= 8388608.0f) || (x <= -8388608.0f))
+     return x;
+  l = (long)x;
+  if((float)l > x)
+     l--;
+  return (float)l;
+}
+
+float f_ceil(float x){
+long l;
+  if((x >= 8388608.0f) || (x <= -8388608.0f))
+     return x;
+  l = (long)x;
+  if((float)l < x)
+     l++;
+  return (float)l;
+}
+
+#ifdef MATH_PROFILE
+/* Average CP0 count ticks (SYSCLK/2) per call of each f_ function
+ * and its library version over the same arguments.
+ */
+void math_profile_report(){
+volatile float sink;
+float arg;
+unsigned long t0,t_lib,t_f;
+int i,fn;
+  while(DMA_IsOn(1));
+  dma_printf("%s","\nMath\tlibm\tf_\n");
+  for(fn = 0; fn < 4; fn++){
+     t0 = CP0_GET(CP0_COUNT);
+     for(i = 0, arg = 0.37f; i < 256; i++, arg += 0.731f){
+        switch(fn){
+           case 0: sink = sqrt(arg); break;
+           case 1: sink = sin(arg); break;
+           case 2: sink = cos(arg); break;
+           case 3: sink = atan2(arg,1.3f - arg); break;
+        }
+     }
+     t_lib = CP0_GET(CP0_COUNT) - t0;
+     t0 = CP0_GET(CP0_COUNT);
+     for(i = 0, arg = 0.37f; i < 256; i++, arg += 0.731f){
+        switch(fn){
+           case 0: sink = f_sqrt(arg); break;
+           case 1: sink = f_sin(arg); break;
+           case 2: sink = f_cos(arg); break;
+           case 3: sink = f_atan2(arg,1.3f - arg); break;
+        }
+     }
+     t_f = CP0_GET(CP0_COUNT) - t0;
+     while(DMA_IsOn(1));
+     dma_printf("%d\t%l\t%l\n",fn,t_lib >> 8,t_f >> 8);
+  }
+}
+#endif
@@ -2,22 +2,37 @@
 #define NUTS_BOLTS_H
 
 #include <stdint.h>
+
+//Axis array index values, defined ahead of Config.h so the headers
+//it pulls in can size their arrays whichever one is included first
+#define N_AXIS 4
+#define X_AXIS 0
+#define Y_AXIS 1
+#define Z_AXIS 2
+#define A_AXIS 3
+
 #include "Config.h"
-//#include "Settings.h"
 
 // Useful macros
 #define clear_vector(a) memset(a, 0, sizeof(a))
 #define clear_vector_float(a) memset(a, 0.0, sizeof(float)*N_AXIS)
 
+//constants carry an f so nothing is pulled up to double,
+//the FPU on the MZ EF only does single precision in hardware
 //mm or inches
-#define MM_PER_INCH (25.40)
-#define INCH_PER_MM (0.0393701)
+#define MM_PER_INCH 25.4f
+#define INCH_PER_MM 0.0393701f
 
 //Circle defines and consts
-#define  Pi         3.1415926535897932384626433832795
-#define  M_Pi       3.141592653589793238462643
-#define  rad2deg    (180.00/M_Pi)
-#define  deg2rad    (M_Pi/180.00)
+#define  Pi         3.14159265f
+#define  M_Pi       3.14159265f
+#define  M_2Pi      6.28318531f
+#define  M_Pi_2     1.57079633f
+#define  rad2deg    57.2957795f
+#define  deg2rad    0.0174532925f
+
+//time the f_ math against the library with the CP0 count register
+//#define MATH_PROFILE
 
 
  //basis macros
@@ -52,12 +67,35 @@ unsigned long flt2ulong(float f_);
 //Conversion from unsigned long to float keeping byte order
 float ulong2flt(unsigned long ui_);
 
-//returns the specific decimal value (rounded value) of the given float
+//returns the given float rounded to 2 decimals
 float fround(float val);
 
-//returns the nearest integer value (rounded value) of the given float
+//returns the nearest integer value of the given float, halves away from 0
 int round(float val);
 
-//returns the nearest long value (rounded value) of the given float
+//returns the nearest long value of the given float, halves away from 0
 long lround(float val);
+
+//float to Q16.16 fixed point and Q16.16 to a decimal string
+long flt2q16(float val);
+long q16_mul_int(long a,long b);
+int  q16_to_str(long q,char *str,int decimals);
+
+//reads a G code number, words may run together as in X10Y5
+int read_float(char *line,int *char_counter,float *value);
+
+//single precision math for the planner, arcs and segment generator
+float f_rsqrt(float x);
+float f_sqrt(float x);
+float f_sin(float x);
+float f_cos(float x);
+float f_atan2(float y,float x);
+float f_fabs(float x);
+float f_floor(float x);
+float f_ceil(float x);
+//div.s is one FPU instruction, nothing to gain from a Newton seed
+#define f_recip(x) (1.0f / (float)(x))
+#ifdef MATH_PROFILE
+void math_profile_report();
+#endif
 #endif
\ No newline at end of file
@@ -2,28 +2,55 @@
 * Author: D Coetzee
 * Date: 05/05/2023
 * Subject: Investigate XY_Interpolation as per   
-<<<<<<< HEAD
 * ac:Pic32Timers                                 
 * ac:XY_Interpolation
 * ac:Pic32mz
 *
-=======
-*  ac:XY_Interpolation
->>>>>>> 5fccbb493b943575cfd5e09931f584d18a7d5345
 **************************************************************/
 
 
 #include "Config.h"
 
+//lines waiting in the serial ring, the DMA receives one line per
+//block so a host that waits for each answer sends one at a time
+static char line[500];
 
-
+/* Runs each line the host has sent and answers it with ok or error,
+ * the host sends the next line on the answer. A line that is only
+ * ~ is cycle start and lets the path run on past an M0, one that
+ * starts $J= jogs the axes by the distances given.
+ */
+static void serial_execute_lines(){
+int dif,start,ok,i;
+  dif = Get_Difference();
+  if(dif <= 0)
+     return;
+  Get_Line(line,dif);
+  line[dif] = 0;
+  start = 0;
+  for(i = 0; i <= dif; i++){
+     if((line[i] != '\n') && (line[i] != 0))
+        continue;
+     line[i] = 0;
+     if(line[start] == '~')
+        ok = st_cycle_start();
+     else if((line[start] == '$') && (line[start+1] == 'J') && (line[start+2] == '='))
+        ok = gc_execute_jog(line + start + 3);
+     else
+        ok = gc_execute_line(line + start);
+     while(DMA_IsOn(1));
+     dma_printf("%s",ok? "ok\n" : "error\n");
+     start = i + 1;
+     if(start >= dif)
+        break;
+  }
+}
 
 void main() {
-static bit m0;
+static bit m0,m1;
  PinMode();
  EI();
- m0 = false;
- setDragOil(20,100,2);
+ m0 = m1 = false;
  while(1){
  //code execution confirmation led on clicker2 board
   #ifdef LED_STATUS
@@ -36,5 +63,28 @@ static bit m0;
   }
   if (SW1 & m0)
       m0 = false;
+  #ifdef PROFILE_REPORT
+  if(!SW2 & !m1){
+     m1 = true;
+     #ifdef STEP_ISR_PROFILE
+     st_isr_profile_report();
+     #endif
+     #ifdef PLANNER_PROFILE
+     plan_profile_report();
+     #endif
+     #ifdef MATH_PROFILE
+     math_profile_report();
+     #endif
+  }
+  if (SW2 & m1)
+      m1 = false;
+  #endif
+  serial_execute_lines();
+  //the planner ran dry, stop holding lines back for arc fitting
+  if(plan_get_block_buffer_count() == 0)
+     mc_flush();
+  //keep the segment buffer full while blocks are queued
+  st_prep_buffer();
+  st_wake_up();
  }
 }
\ No newline at end of file
@@ -75,4 +75,32 @@ sbit X_Min_Limit_Dir at TRISF3_bit;
 sbit Y_Min_Limit at RB15_bit;
 sbit Y_Min_Limit_Dir at TRISB15_bit;
 sbit Z_Min_Limit at RB1_bit;
-sbit Z_Min_Limit_Dir at TRISB1_bit;
\ No newline at end of file
+sbit Z_Min_Limit_Dir at TRISB1_bit;
+
+
+//////////////////////////////////////////
+//Axis bits to LATx masks for the step isr
+const unsigned int step_lat_d[16] = {
+   STEP_PORT_D(0), STEP_PORT_D(1), STEP_PORT_D(2), STEP_PORT_D(3),
+   STEP_PORT_D(4), STEP_PORT_D(5), STEP_PORT_D(6), STEP_PORT_D(7),
+   STEP_PORT_D(8), STEP_PORT_D(9), STEP_PORT_D(10),STEP_PORT_D(11),
+   STEP_PORT_D(12),STEP_PORT_D(13),STEP_PORT_D(14),STEP_PORT_D(15)
+};
+const unsigned int step_lat_f[16] = {
+   STEP_PORT_F(0), STEP_PORT_F(1), STEP_PORT_F(2), STEP_PORT_F(3),
+   STEP_PORT_F(4), STEP_PORT_F(5), STEP_PORT_F(6), STEP_PORT_F(7),
+   STEP_PORT_F(8), STEP_PORT_F(9), STEP_PORT_F(10),STEP_PORT_F(11),
+   STEP_PORT_F(12),STEP_PORT_F(13),STEP_PORT_F(14),STEP_PORT_F(15)
+};
+const unsigned int dir_lat_g[16] = {
+   DIR_PORT_G(0), DIR_PORT_G(1), DIR_PORT_G(2), DIR_PORT_G(3),
+   DIR_PORT_G(4), DIR_PORT_G(5), DIR_PORT_G(6), DIR_PORT_G(7),
+   DIR_PORT_G(8), DIR_PORT_G(9), DIR_PORT_G(10),DIR_PORT_G(11),
+   DIR_PORT_G(12),DIR_PORT_G(13),DIR_PORT_G(14),DIR_PORT_G(15)
+};
+const unsigned int dir_lat_e[16] = {
+   DIR_PORT_E(0), DIR_PORT_E(1), DIR_PORT_E(2), DIR_PORT_E(3),
+   DIR_PORT_E(4), DIR_PORT_E(5), DIR_PORT_E(6), DIR_PORT_E(7),
+   DIR_PORT_E(8), DIR_PORT_E(9), DIR_PORT_E(10),DIR_PORT_E(11),
+   DIR_PORT_E(12),DIR_PORT_E(13),DIR_PORT_E(14),DIR_PORT_E(15)
+};
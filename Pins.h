@@ -92,5 +92,41 @@ extern sfr sbit Z_Min_Limit_Dir;
 #define Z_DIR_DIR  1
 #define A_DIR_DIR  0
 
+/////////////////////////////////////////////////////
+//Step and direction pin map, these must match the sbits
+//in Pins.c. Bits are grouped per port so a step event is
+//one LATxSET and one LATxCLR write per port.
+#define X_STEP_BIT  (1 << 4)    //RD4
+#define Y_STEP_BIT  (1 << 5)    //RD5
+#define Z_STEP_BIT  (1 << 0)    //RF0
+#define A_STEP_BIT  (1 << 1)    //RF1
+#define STEP_MASK_D (X_STEP_BIT | Y_STEP_BIT)
+#define STEP_MASK_F (Z_STEP_BIT | A_STEP_BIT)
+
+#define X_DIR_BIT   (1 << 12)   //RG12
+#define Y_DIR_BIT   (1 << 2)    //RE2
+#define Z_DIR_BIT   (1 << 15)   //RG15
+#define A_DIR_BIT   (1 << 5)    //RE5
+#define DIR_MASK_G  (X_DIR_BIT | Z_DIR_BIT)
+#define DIR_MASK_E  (Y_DIR_BIT | A_DIR_BIT)
+
+//spindle PWM is OC9 on RB9, direction is set for M4
+#define SPINDLE_DIR_BIT (1 << 10)  //RB10
+
+//axis bits [X=0,Y=1,Z=2,A=3] to port bits
+#define STEP_PORT_D(b) ((((b) & 1)? X_STEP_BIT : 0) | (((b) & 2)? Y_STEP_BIT : 0))
+#define STEP_PORT_F(b) ((((b) & 4)? Z_STEP_BIT : 0) | (((b) & 8)? A_STEP_BIT : 0))
+//direction bits are set for -ve travel, XOR the pin polarity
+#define DIR_PORT_G(b)  (((((((b) & 1) != 0) ^ X_DIR_DIR)? X_DIR_BIT : 0)) | \
+                        ((((((b) & 4) != 0) ^ Z_DIR_DIR)? Z_DIR_BIT : 0)))
+#define DIR_PORT_E(b)  (((((((b) & 2) != 0) ^ Y_DIR_DIR)? Y_DIR_BIT : 0)) | \
+                        ((((((b) & 8) != 0) ^ A_DIR_DIR)? A_DIR_BIT : 0)))
+
+//lookup by axis bits, built at compile time in Pins.c
+extern const unsigned int step_lat_d[16];
+extern const unsigned int step_lat_f[16];
+extern const unsigned int dir_lat_g[16];
+extern const unsigned int dir_lat_e[16];
+
 
 #endif
\ No newline at end of file
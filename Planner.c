@@ -0,0 +1,521 @@
+#include "Planner.h"
+
+
+//steps per mm in Q16.16 for the mm to steps conversion
+static long steps_per_mm_q16[N_AXIS];
+
+static Block block_buffer[BLOCK_BUFFER_SIZE];
+
+/* Look ahead fields as parallel arrays apart from the blocks, so
+ * the backward and forward passes walk three runs of consecutive
+ * words through the D-cache instead of striding over whole blocks.
+ * Each array is a whole number of 16 byte cache lines.
+ */
+static struct{
+ float entry_speed_sqr[BLOCK_BUFFER_SIZE];     // planned speed into the block
+ float max_entry_speed_sqr[BLOCK_BUFFER_SIZE]; // junction limited entry speed
+ float delta_speed_sqr[BLOCK_BUFFER_SIZE];     // 2*acceleration*millimeters
+}pv;
+static unsigned char block_buffer_tail;  // block being executed
+static unsigned char block_buffer_head;  // next free block
+static unsigned char next_buffer_head;
+//blocks from the tail up to here cannot be improved by replanning
+static unsigned char block_buffer_planned;
+
+#ifdef PLANNER_PROFILE
+//planner_recalculate cost in CP0 count ticks (SYSCLK/2)
+static struct{
+ unsigned long cycles_max;
+ unsigned long cycles_sum;
+ unsigned long count;
+}plan_prof;
+#endif
+
+//planner state kept between blocks
+static struct{
+ long position[N_AXIS];        // planned end point in steps
+ float previous_unit_vec[N_AXIS];
+ float previous_nominal_speed_sqr;
+ unsigned int spindle_duty;    // stamped on each block queued
+ unsigned char spindle_state;
+ unsigned char raster;         // G7 pixel slot or RASTER_NONE
+}pl;
+
+#ifdef PLAN_MERGE_TOLERANCE
+//move held back while the moves after it are collinear with it
+static struct{
+ float start[N_AXIS];          // end of the queue in mm
+ float target[N_AXIS];         // end of the merged move in mm
+ float point[PLAN_MERGE_MAX_POINTS][N_AXIS]; // corners merged away
+ float feed_rate;
+ int   n_point;
+ char  active;
+}merge;
+#endif
+
+
+static unsigned char next_block_index(unsigned char block_index){
+  block_index++;
+  if(block_index == BLOCK_BUFFER_SIZE)
+     block_index = 0;
+  return block_index;
+}
+
+static unsigned char prev_block_index(unsigned char block_index){
+  if(block_index == 0)
+     block_index = BLOCK_BUFFER_SIZE;
+  block_index--;
+  return block_index;
+}
+
+void plan_reset(){
+  plan_update_settings();
+  memset(block_buffer,0,sizeof(block_buffer));
+  memset(&pv,0,sizeof(pv));
+  memset(&pl,0,sizeof(pl));
+  pl.raster = RASTER_NONE;
+#ifdef PLAN_MERGE_TOLERANCE
+  merge.active = 0;
+#endif
+  block_buffer_tail = 0;
+  block_buffer_head = 0;
+  next_buffer_head  = 1;
+  block_buffer_planned = 0;
+}
+
+/* Look ahead from the new block back to block_buffer_planned. The
+ * backward pass limits each entry speed so the block can still
+ * decelerate into the block after it, the last block must come to
+ * a stop. A block already at its max entry speed cannot go higher
+ * so it is skipped. The forward pass then limits entry speeds to
+ * what the block before can reach, and moves block_buffer_planned
+ * up to the last block whose entry is fixed by acceleration from
+ * the tail or is at its max, nothing before that can change when
+ * more blocks are added. The executing block at the tail keeps its
+ * entry speed.
+ */
+static void planner_recalculate(){
+unsigned char block_index,next_index;
+float entry_speed_sqr;
+
+  block_index = prev_block_index(block_buffer_head);
+  if(block_index == block_buffer_planned)
+     return;
+  pv.entry_speed_sqr[block_index] = min(pv.max_entry_speed_sqr[block_index],
+                                        pv.delta_speed_sqr[block_index]);
+
+  //backward pass
+  next_index = block_index;
+  block_index = prev_block_index(block_index);
+  while(block_index != block_buffer_planned){
+     if(pv.entry_speed_sqr[block_index] != pv.max_entry_speed_sqr[block_index]){
+        entry_speed_sqr = pv.entry_speed_sqr[next_index] + pv.delta_speed_sqr[block_index];
+        pv.entry_speed_sqr[block_index] = min(pv.max_entry_speed_sqr[block_index],entry_speed_sqr);
+     }
+     next_index = block_index;
+     block_index = prev_block_index(block_index);
+  }
+
+  //forward pass
+  block_index = block_buffer_planned;
+  next_index = next_block_index(block_index);
+  while(next_index != block_buffer_head){
+     if(pv.entry_speed_sqr[block_index] < pv.entry_speed_sqr[next_index]){
+        entry_speed_sqr = pv.entry_speed_sqr[block_index] + pv.delta_speed_sqr[block_index];
+        if(entry_speed_sqr < pv.entry_speed_sqr[next_index]){
+           //acceleration limited, everything up to here is final
+           pv.entry_speed_sqr[next_index] = entry_speed_sqr;
+           block_buffer_planned = next_index;
+        }
+     }
+     if(pv.entry_speed_sqr[next_index] == pv.max_entry_speed_sqr[next_index])
+        block_buffer_planned = next_index;
+     block_index = next_index;
+     next_index = next_block_index(next_index);
+  }
+}
+
+/* Add a linear move to the queue, target is absolute in mm and
+ * feed_rate is in mm/min. Returns 0 if the move had no steps.
+ */
+static int plan_queue_line(float *target,float feed_rate){
+Block *block;
+long target_steps[N_AXIS];
+float unit_vec[N_AXIS],delta_mm,inverse_mm;
+float junction_cos_theta,sin_theta_d2,nominal_speed,limit,max_entry_speed_sqr;
+#ifdef PLANNER_PROFILE
+unsigned long t0;
+#endif
+int i;
+
+  block = &block_buffer[block_buffer_head];
+  memset(block,0,sizeof(Block));
+  block->spindle_duty = pl.spindle_duty;
+  block->spindle_state = pl.spindle_state;
+  block->raster = pl.raster;
+
+  for(i = 0; i < N_AXIS; i++){
+     target_steps[i] = plan_mm_to_steps(target[i],i);
+     block->steps[i] = labs(target_steps[i] - pl.position[i]);
+     block->step_event_count = max(block->step_event_count,block->steps[i]);
+     delta_mm = (target_steps[i] - pl.position[i]) / settings.steps_per_mm[i];
+     unit_vec[i] = delta_mm;
+     if(delta_mm < 0.0f)
+        bit_true(block->direction_bits,bit(i));
+     block->millimeters += delta_mm * delta_mm;
+  }
+  if(block->step_event_count == 0)
+     return 0;
+  block->millimeters = f_sqrt(block->millimeters);
+
+  //pure single axis and equal step moves need no error terms
+  block->line_type = LINE_SINGLE;
+  for(i = 0; i < N_AXIS; i++){
+     if(block->steps[i] == 0)
+        continue;
+     if(block->steps[i] != block->step_event_count)
+        block->line_type = LINE_GENERAL;
+     else if(block->axis_mask && (block->line_type == LINE_SINGLE))
+        block->line_type = LINE_DIAGONAL;
+     bit_true(block->axis_mask,bit(i));
+  }
+
+  //limit speed and acceleration to the slowest axis in the move
+  inverse_mm = 1.0f / block->millimeters;
+  if(feed_rate < MINIMUM_FEED_RATE)
+     feed_rate = MINIMUM_FEED_RATE;
+  nominal_speed = feed_rate / 60.0f;
+  block->acceleration = 1.0e9f;
+  for(i = 0; i < N_AXIS; i++){
+     unit_vec[i] *= inverse_mm;
+     if(unit_vec[i] != 0.0f){
+        limit = f_fabs(settings.max_rate[i] / (60.0f * unit_vec[i]));
+        if(limit < nominal_speed)
+           nominal_speed = limit;
+        limit = f_fabs(settings.acceleration[i] / unit_vec[i]);
+        if(limit < block->acceleration)
+           block->acceleration = limit;
+     }
+  }
+  block->nominal_speed_sqr = nominal_speed * nominal_speed;
+
+  //junction deviation limits the speed through the corner with
+  //the previous block, an empty queue always starts from rest
+  pv.entry_speed_sqr[block_buffer_head] = 0.0f;
+  pv.delta_speed_sqr[block_buffer_head] = 2 * block->acceleration * block->millimeters;
+  max_entry_speed_sqr = MINIMUM_JUNCTION_SPEED * MINIMUM_JUNCTION_SPEED;
+  if(block_buffer_head != block_buffer_tail){
+     junction_cos_theta = 0.0f;
+     for(i = 0; i < N_AXIS; i++)
+        junction_cos_theta -= pl.previous_unit_vec[i] * unit_vec[i];
+     if(junction_cos_theta < -0.999999f){
+        //straight line, only the nominal speeds limit
+        max_entry_speed_sqr = min(block->nominal_speed_sqr,pl.previous_nominal_speed_sqr);
+     }else if(junction_cos_theta < 0.999999f){
+        sin_theta_d2 = f_sqrt(0.5f * (1.0f - junction_cos_theta));
+        limit = block->acceleration * settings.junction_deviation * sin_theta_d2 / (1.0f - sin_theta_d2);
+        limit = min(limit,block->nominal_speed_sqr);
+        max_entry_speed_sqr = min(limit,pl.previous_nominal_speed_sqr);
+     }
+  }
+  pv.max_entry_speed_sqr[block_buffer_head] = max_entry_speed_sqr;
+
+  memcpy(pl.previous_unit_vec,unit_vec,sizeof(unit_vec));
+  memcpy(pl.position,target_steps,sizeof(target_steps));
+  pl.previous_nominal_speed_sqr = block->nominal_speed_sqr;
+
+  block_buffer_head = next_buffer_head;
+  next_buffer_head  = next_block_index(block_buffer_head);
+#ifdef PLANNER_PROFILE
+  t0 = CP0_GET(CP0_COUNT);
+  planner_recalculate();
+  t0 = CP0_GET(CP0_COUNT) - t0;
+  plan_prof.cycles_sum += t0;
+  plan_prof.count++;
+  if(t0 > plan_prof.cycles_max)
+     plan_prof.cycles_max = t0;
+#else
+  planner_recalculate();
+#endif
+  return 1;
+}
+
+#ifdef PLAN_MERGE_TOLERANCE
+//point lies within the tolerance of the line and between its ends
+static int merge_point_fits(float *point,float *unit_vec,float length){
+float d[N_AXIS],t,dist_sqr;
+int i;
+  t = 0.0f;
+  for(i = 0; i < N_AXIS; i++){
+     d[i] = point[i] - merge.start[i];
+     t += d[i] * unit_vec[i];
+  }
+  if((t <= 0.0f) || (t >= length))
+     return 0;
+  dist_sqr = 0.0f;
+  for(i = 0; i < N_AXIS; i++){
+     d[i] -= t * unit_vec[i];
+     dist_sqr += d[i] * d[i];
+  }
+  return (dist_sqr <= PLAN_MERGE_TOLERANCE * PLAN_MERGE_TOLERANCE);
+}
+
+/* True if the corners already merged away and the end of the held
+ * move all stay on the straight line from the start to target.
+ */
+static int merge_fits(float *target){
+float unit_vec[N_AXIS],length;
+int i;
+  length = 0.0f;
+  for(i = 0; i < N_AXIS; i++){
+     unit_vec[i] = target[i] - merge.start[i];
+     length += unit_vec[i] * unit_vec[i];
+  }
+  length = f_sqrt(length);
+  if(length == 0.0f)
+     return 0;
+  for(i = 0; i < N_AXIS; i++)
+     unit_vec[i] /= length;
+
+  if(!merge_point_fits(merge.target,unit_vec,length))
+     return 0;
+  for(i = 0; i < merge.n_point; i++){
+     if(!merge_point_fits(merge.point[i],unit_vec,length))
+        return 0;
+  }
+  return 1;
+}
+
+//queue the held move, it starts where the queue ends
+static void merge_flush(){
+  if(!merge.active)
+     return;
+  merge.active = 0;
+  plan_queue_line(merge.target,merge.feed_rate);
+}
+#endif
+
+/* Add a linear move, target is absolute in mm and feed_rate is in
+ * mm/min. Short moves are held back and merged with the moves after
+ * them while they stay on one line within PLAN_MERGE_TOLERANCE, the
+ * held move is queued when a move does not fit or the queue runs
+ * dry. Returns 0 if the move had no length.
+ * Caller must check plan_check_full_buffer() first.
+ */
+int plan_buffer_line(float *target,float feed_rate){
+#ifdef PLAN_MERGE_TOLERANCE
+float position[N_AXIS],length_sqr,d;
+int i;
+  plan_get_position(position);
+  length_sqr = 0.0f;
+  for(i = 0; i < N_AXIS; i++){
+     d = target[i] - position[i];
+     length_sqr += d * d;
+  }
+  if(length_sqr == 0.0f)
+     return 0;
+
+  if(merge.active){
+     if((feed_rate == merge.feed_rate) && (merge.n_point < PLAN_MERGE_MAX_POINTS) &&
+        (length_sqr < PLAN_MERGE_MAX_LENGTH * PLAN_MERGE_MAX_LENGTH) && merge_fits(target)){
+        memcpy(merge.point[merge.n_point],merge.target,sizeof(merge.target));
+        merge.n_point++;
+        memcpy(merge.target,target,sizeof(merge.target));
+        return 1;
+     }
+     merge_flush();
+  }
+
+  if(length_sqr >= PLAN_MERGE_MAX_LENGTH * PLAN_MERGE_MAX_LENGTH)
+     return plan_queue_line(target,feed_rate);
+  memcpy(merge.start,position,sizeof(position));
+  memcpy(merge.target,target,sizeof(merge.target));
+  merge.feed_rate = feed_rate;
+  merge.n_point = 0;
+  merge.active = 1;
+  return 1;
+#else
+  return plan_queue_line(target,feed_rate);
+#endif
+}
+
+/* Queue a G4 dwell, or an M0 hold with DWELL_HOLD, as a block with
+ * no steps. It has no length so the look ahead brings the path to
+ * rest before it, and the move after it starts from rest. Anything
+ * held back for merging is queued first. Returns 0 if seconds is 0.
+ * Caller must check plan_check_full_buffer() first.
+ */
+int plan_buffer_dwell(float seconds){
+Block *block;
+  if(seconds == 0.0f)
+     return 0;
+#ifdef PLAN_MERGE_TOLERANCE
+  merge_flush();
+#endif
+  block = &block_buffer[block_buffer_head];
+  memset(block,0,sizeof(Block));
+  block->dwell = seconds;
+  block->line_type = LINE_SINGLE;
+  block->spindle_duty = pl.spindle_duty;
+  block->spindle_state = pl.spindle_state;
+  block->raster = RASTER_NONE;
+  pv.entry_speed_sqr[block_buffer_head] = 0.0f;
+  pv.max_entry_speed_sqr[block_buffer_head] = 0.0f;
+  pv.delta_speed_sqr[block_buffer_head] = 0.0f;
+  pl.previous_nominal_speed_sqr = 0.0f;
+
+  block_buffer_head = next_buffer_head;
+  next_buffer_head  = next_block_index(block_buffer_head);
+  planner_recalculate();
+  return 1;
+}
+
+/* Spindle state for the blocks queued from here on, the stepper
+ * sets it as the first of them starts so the path runs on through
+ * the change. A held merged move is queued first with the old state.
+ * Caller must check plan_check_full_buffer() first.
+ */
+void plan_set_spindle(int state,unsigned int duty){
+#ifdef PLAN_MERGE_TOLERANCE
+  merge_flush();
+#endif
+  pl.spindle_state = state;
+  pl.spindle_duty = duty;
+}
+
+int plan_get_spindle_state(){
+  return pl.spindle_state;
+}
+
+unsigned int plan_get_spindle_duty(){
+  return pl.spindle_duty;
+}
+
+/* G7 pixel slot for the lines queued from here on, RASTER_NONE ends
+ * the scan. A held merged move is queued first so a scan line is
+ * never merged with the moves either side of it.
+ * Caller must check plan_check_full_buffer() first.
+ */
+void plan_set_raster(int slot){
+#ifdef PLAN_MERGE_TOLERANCE
+  merge_flush();
+#endif
+  pl.raster = slot;
+}
+
+//block at the tail or NULL if the queue is empty
+Block* plan_get_current_block(){
+#ifdef PLAN_MERGE_TOLERANCE
+  //the stepper is starved, stop holding the merged move back
+  if((block_buffer_head == block_buffer_tail) && merge.active)
+     merge_flush();
+#endif
+  if(block_buffer_head == block_buffer_tail)
+     return NULL;
+  return &block_buffer[block_buffer_tail];
+}
+
+//free the tail block once the stepper is finished with it
+void plan_discard_current_block(){
+  if(block_buffer_head != block_buffer_tail){
+     if(block_buffer_tail == block_buffer_planned)
+        block_buffer_planned = next_block_index(block_buffer_tail);
+     block_buffer_tail = next_block_index(block_buffer_tail);
+  }
+}
+
+//exit speed of the executing block is the entry of the next
+float plan_get_exec_block_exit_speed_sqr(){
+unsigned char block_index;
+  block_index = next_block_index(block_buffer_tail);
+  if(block_index == block_buffer_head)
+     return 0.0f;
+  return pv.entry_speed_sqr[block_index];
+}
+
+int plan_check_full_buffer(){
+#ifdef PLAN_MERGE_TOLERANCE
+  //keep a slot free for the held move to be flushed into
+  if(merge.active && (block_buffer_tail == next_block_index(next_buffer_head)))
+     return 1;
+#endif
+  return (block_buffer_tail == next_buffer_head);
+}
+
+int plan_get_block_buffer_count(){
+  if(block_buffer_head >= block_buffer_tail)
+     return block_buffer_head - block_buffer_tail;
+  return BLOCK_BUFFER_SIZE - (block_buffer_tail - block_buffer_head);
+}
+
+/* Absolute position in mm to steps. The mm are taken to Q16.16,
+ * 15nm, and multiplied by steps per mm in integers so the same
+ * target gives the same step on every run and on the host.
+ */
+long plan_mm_to_steps(float mm,int axis){
+  return q16_mul_int(flt2q16(mm),steps_per_mm_q16[axis]);
+}
+
+//take up new steps per mm from the settings, call while idle
+void plan_update_settings(){
+int i;
+  for(i = 0; i < N_AXIS; i++)
+     steps_per_mm_q16[i] = flt2q16(settings.steps_per_mm[i]);
+}
+
+float plan_get_steps_per_mm(int axis){
+  return settings.steps_per_mm[axis];
+}
+
+//planned end point of the queue in mm
+void plan_get_position(float *position){
+int i;
+#ifdef PLAN_MERGE_TOLERANCE
+  if(merge.active){
+     memcpy(position,merge.target,sizeof(merge.target));
+     return;
+  }
+#endif
+  for(i = 0; i < N_AXIS; i++)
+     position[i] = pl.position[i] / settings.steps_per_mm[i];
+}
+
+float plan_get_max_rate(int axis){
+  return settings.max_rate[axis];
+}
+
+float plan_get_acceleration(int axis){
+  return settings.acceleration[axis];
+}
+
+//moves made outside the planner set where the queue ends in steps
+void plan_set_position(long *position){
+#ifdef PLAN_MERGE_TOLERANCE
+  merge.active = 0;
+#endif
+  memcpy(pl.position,position,sizeof(pl.position));
+  memset(pl.previous_unit_vec,0,sizeof(pl.previous_unit_vec));
+  pl.previous_nominal_speed_sqr = 0.0f;
+}
+
+//restart planning from where the machine actually is
+void plan_sync_position(){
+long position[N_AXIS];
+  st_get_position(position);
+  plan_set_position(position);
+}
+
+#ifdef PLANNER_PROFILE
+/* Print the look ahead cost per block queued with the queue depth
+ * and clear the counts.
+ */
+void plan_profile_report(){
+  while(DMA_IsOn(1));
+  dma_printf("%s","\nPlan\tBlocks\tAvg\tMax\tDepth\n");
+  while(DMA_IsOn(1));
+  dma_printf("\t%l\t%l\t%l\t%d\n",plan_prof.count,
+            plan_prof.count? plan_prof.cycles_sum / plan_prof.count : 0,
+            plan_prof.cycles_max,plan_get_block_buffer_count());
+  memset(&plan_prof,0,sizeof(plan_prof));
+}
+#endif
@@ -0,0 +1,84 @@
+#ifndef PLANNER_H
+#define PLANNER_H
+
+#include "Nuts_Bolts.h"
+#include "built_in.h"
+
+////////////////////////////////////////////////////
+//DEFINES
+//number of linear motions held in the planner queue, replanning
+//stops at the first optimal block so depth costs little
+#define BLOCK_BUFFER_SIZE 64
+
+//feed used when none has been programmed
+#define DEFAULT_FEEDRATE 600.0f // mm/min
+
+//line classes picked at plan time for the step isr
+#define LINE_GENERAL  0 // Bresenham over all axes
+#define LINE_SINGLE   1 // one axis moves, no error term
+#define LINE_DIAGONAL 2 // all moving axes step in lock-step
+
+//short moves that stay within the tolerance of one straight line
+//are merged into a single block before they reach the queue,
+//comment out PLAN_MERGE_TOLERANCE to queue every move as sent
+#define PLAN_MERGE_TOLERANCE 0.005f // mm
+#define PLAN_MERGE_MAX_LENGTH 0.5f  // mm, longer moves are not merged
+#define PLAN_MERGE_MAX_POINTS 16   // moves held in one merged block
+
+//time planner_recalculate with the CP0 count register
+//#define PLANNER_PROFILE
+
+//dwell time that holds the path at an M0 until cycle start
+#define DWELL_HOLD -1.0f
+
+//speeds below this are treated as a stop in mm/sec
+#define MINIMUM_JUNCTION_SPEED 0.0f
+#define MINIMUM_FEED_RATE 1.0f // mm/min
+
+////////////////////////////////////////////////////
+//STRUCTS and ENUMS
+//one linear move, speeds are held squared in (mm/sec)^2. The
+//entry speeds the look ahead works on are kept in the planner's
+//own arrays, see plan_get_exec_block_exit_speed_sqr()
+typedef struct{
+ unsigned long steps[N_AXIS];  // steps per axis for the move
+ unsigned long step_event_count;// steps of the dominant axis
+ unsigned char direction_bits; // bit(axis) set for -ve travel
+ unsigned char axis_mask;      // bit(axis) set for moving axes
+ unsigned char line_type;      // LINE_GENERAL,SINGLE or DIAGONAL
+ float nominal_speed_sqr;      // programmed speed limited by axes
+ float acceleration;           // mm/sec^2 limited by axes
+ float millimeters;            // length of the move
+ float dwell;                  // G4 secs with no steps, or DWELL_HOLD
+ unsigned int spindle_duty;    // PWM duty while the block runs
+ unsigned char spindle_state;  // SPINDLE_OFF, CW or CCW
+ unsigned char raster;         // G7 pixel slot or RASTER_NONE
+}Block;
+
+////////////////////////////////////////////////////
+//function prototypes
+void plan_reset();
+int  plan_buffer_line(float *target,float feed_rate);
+int  plan_buffer_dwell(float seconds);
+void plan_set_spindle(int state,unsigned int duty);
+int  plan_get_spindle_state();
+unsigned int plan_get_spindle_duty();
+void plan_set_raster(int slot);
+Block* plan_get_current_block();
+void plan_discard_current_block();
+float plan_get_exec_block_exit_speed_sqr();
+int  plan_check_full_buffer();
+int  plan_get_block_buffer_count();
+long plan_mm_to_steps(float mm,int axis);
+void plan_update_settings();
+float plan_get_steps_per_mm(int axis);
+float plan_get_max_rate(int axis);
+float plan_get_acceleration(int axis);
+void plan_get_position(float *position);
+void plan_set_position(long *position);
+void plan_sync_position();
+#ifdef PLANNER_PROFILE
+void plan_profile_report();
+#endif
+
+#endif
@@ -0,0 +1,95 @@
+#include "Raster.h"
+
+//pixel runs of the queued scan lines, used and freed in order
+static struct{
+ unsigned char pixel[RASTER_BUFFER_SIZE][RASTER_MAX_PIXELS];
+ unsigned char n_pixel[RASTER_BUFFER_SIZE];
+ unsigned char head;
+ unsigned char tail;
+ unsigned char count;
+}raster;
+
+static int base64_value(char c){
+  if((c >= 'A') && (c <= 'Z'))
+     return c - 'A';
+  if((c >= 'a') && (c <= 'z'))
+     return c - 'a' + 26;
+  if((c >= '0') && (c <= '9'))
+     return c - '0' + 52;
+  if(c == '+')
+     return 62;
+  if(c == '/')
+     return 63;
+  return -1;
+}
+
+//base64 to pixel bytes, stops at the padding or end of the line.
+//Returns the number of pixels or -1 if there are too many
+static int raster_decode(char *s,unsigned char *pixel){
+unsigned long bits;
+int n_bits,n,v;
+  bits = 0;
+  n_bits = 0;
+  n = 0;
+  while((v = base64_value(*s)) >= 0){
+     bits = (bits << 6) | v;
+     n_bits += 6;
+     if(n_bits >= 8){
+        if(n == RASTER_MAX_PIXELS)
+           return -1;
+        n_bits -= 8;
+        pixel[n++] = (bits >> n_bits) & 0xFF;
+        bits &= (1 << n_bits) - 1;
+     }
+     s++;
+  }
+  return n;
+}
+
+/* G7 scan line from start to target in machine coords, with the
+ * pixel powers 0..255 of rpm in data as base64. The pixels are
+ * spread evenly along the line and each one's power starts on its
+ * first step. Compared to a G1 with an S word per pixel the line is
+ * about a tenth the size. The slot is counted before the line is
+ * queued, as the stepper may be done with it before mc_raster()
+ * returns, and given back if nothing was queued. Returns 0 for bad
+ * data or a line that moves no axis a step.
+ */
+int raster_line(float *start,float *target,float feed_rate,float rpm,char *data){
+int slot,n;
+  //wait for the stepper to finish with the oldest line
+  while(raster.count == RASTER_BUFFER_SIZE){
+     st_prep_buffer();
+     st_wake_up();
+  }
+  slot = raster.head;
+  n = raster_decode(data,raster.pixel[slot]);
+  if(n <= 0)
+     return 0;
+  raster.n_pixel[slot] = n;
+  if(++raster.head == RASTER_BUFFER_SIZE)
+     raster.head = 0;
+  raster.count++;
+  if(mc_raster(start,target,feed_rate,rpm,slot))
+     return 1;
+  raster.head = slot;
+  raster.count--;
+  return 0;
+}
+
+unsigned char *raster_get_pixels(int slot){
+  return raster.pixel[slot];
+}
+
+int raster_get_count(int slot){
+  return raster.n_pixel[slot];
+}
+
+//the segment generator is done with the oldest line
+void raster_release(){
+  if(raster.count == 0)
+     return;
+  raster.count--;
+  if(++raster.tail == RASTER_BUFFER_SIZE)
+     raster.tail = 0;
+}
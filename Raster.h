@@ -0,0 +1,25 @@
+#ifndef RASTER_H
+#define RASTER_H
+
+#include "Config.h"
+#include "built_in.h"
+
+////////////////////////////////////////////////////
+//DEFINES
+//G7 scan lines held from the serial line until their last pixel
+//is cut into segments
+#define RASTER_BUFFER_SIZE 8
+//pixels per G7 line, 96 pixels are 128 base64 chars which with the
+//words in front stays inside the 200 byte DMA receive block
+#define RASTER_MAX_PIXELS 96
+//planner blocks that are not part of a scan line
+#define RASTER_NONE 0xFF
+
+////////////////////////////////////////////////////
+//function prototypes
+int  raster_line(float *start,float *target,float feed_rate,float rpm,char *data);
+unsigned char *raster_get_pixels(int slot);
+int  raster_get_count(int slot);
+void raster_release();
+
+#endif
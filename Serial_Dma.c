@@ -45,7 +45,6 @@ void  DMA0(){
     //Disable DMA0 and reset priority
     DCH0CONCLR = 0x8003;
 
-<<<<<<< HEAD
 #ifdef UART1_DMA
    //INTERRUPT IRQ NUMBER for UART 1 RX (113) | [0x10 = SIRQEN] [0x30 = PATEN & SIRQEN]
     DCH0ECON      =  (113 << 8 ) | 0x30;
@@ -63,16 +62,6 @@ void  DMA0(){
     //Source address as UART2_RX
     DCH0SSA       = KVA_TO_PA(0xBF822230);    //[0xBF822230 = U2RXREG]
    #endif
-=======
-    //1INTERRUPT IRQ NUMBER for UART 2 TX (146) | [0x10 = SIRQEN] [0x30 = PATEN & SIRQEN]
-    DCH0ECON      =  (146 << 8 ) | 0x30;
-
-    //Pattern data
-    DCH0DAT       = '?';//'\0' //0x0A0D;//'\r\n';
-
-    //Source address as UART_RX
-    DCH0SSA       = KVA_TO_PA(0xBF822230);    //[0xBF822230 = U2RXREG]
->>>>>>> 5fccbb493b943575cfd5e09931f584d18a7d5345
     DCH0SSIZ      = 1;                 // source size = 1byte at a time
 
     //Destination address  as RxBuffer
@@ -219,10 +208,11 @@ void Reset_Ring(){
    serial.tail = serial.head = 0;
 }
 
-//read the line from thebuffer
+//read the line from thebuffer, the isr starts a line that would
+//run past the end at 0 so the tail follows the head round
 void Get_Line(char *str,int dif){
 
-   if(serial.tail + dif > 499)
+   if((serial.tail + dif > 499) || (serial.tail > serial.head))
       serial.tail = 0;
 
     strncpy(str,serial.temp_buffer+serial.tail,dif);
@@ -270,7 +260,6 @@ void DMA1(){
      //Disable DMA0 and reset priority
     DCH1CONCLR = 0x8003;
 
-<<<<<<< HEAD
 #ifdef UART1_
     //INTERRUPT IRQ NUMBER for UART 1 TX (114) | [0x10 = SIRQEN] [0x30 = PATEN & SIRQEN]
     DCH1ECON=(114 << 8)| 0x30;
@@ -278,11 +267,6 @@ void DMA1(){
     //INTERRUPT IRQ NUMBER for UART 2 TX (147) | [0x10 = SIRQEN] [0x30 = PATEN & SIRQEN]
     DCH1ECON=(147 << 8)| 0x30;
 #endif
-=======
-    //INTERRUPT IRQ NUMBER for UART 2 TX (147) | [0x10 = SIRQEN] [0x30 = PATEN & SIRQEN]
-    DCH1ECON=(147 << 8)| 0x30;
-
->>>>>>> 5fccbb493b943575cfd5e09931f584d18a7d5345
     //Pattern Length and char to match not needed here ????
     //Pattern length = 0 = 1 byte
     DCH1DAT       = '\0';
@@ -294,15 +278,11 @@ void DMA1(){
     //Destination Address and size which is 1byte
     //U1TX2REG for reply  [0xBF822220 = U1TXREG]
     U1TXREG   = 0x00;
-<<<<<<< HEAD
     #ifdef UART1_DMA
     DCH1DSA   = KVA_TO_PA(0xBF822020) ;
     #elif UART2_DMA
     DCH1DSA   = KVA_TO_PA(0xBF822220) ;
     #endif
-=======
-    DCH1DSA   = KVA_TO_PA(0xBF822220) ;
->>>>>>> 5fccbb493b943575cfd5e09931f584d18a7d5345
     DCH1DSIZ  = 1;
 
     //Cell size to transfer each transfer
@@ -0,0 +1,275 @@
+#include "Settings.h"
+
+//records are flash quad words, blank flash reads all 1's
+#define SETTINGS_QUAD_SIZE 16
+#define SETTINGS_QUADS (SETTINGS_PAGE_SIZE / SETTINGS_QUAD_SIZE)
+#define SETTINGS_MAGIC 0x53455454   // "SETT"
+#define SETTINGS_TAG   0x5E710000   // high half of a record key
+#define SETTINGS_LAYOUT (SETTINGS_VERSION | ((unsigned long)SETTING_COUNT << 16))
+
+//NVMCON bits
+#define NVM_WR        0x8000
+#define NVM_WREN      0x4000
+#define NVM_ERR       0x3000        // WRERR | LVDERR
+#define NVM_QUAD_WORD 0x0002
+#define NVM_PAGE_ERASE 0x0004
+
+//uncached KSEG1 view of a physical flash address so a record is
+//read back from the array and not from a stale cache line. The
+//host tests point it at a RAM copy of the two pages instead
+#ifndef FLASH_PTR
+#define FLASH_PTR(pa) ((unsigned long*)((pa) | 0xA0000000))
+#endif
+
+Settings settings;
+
+static const Settings settings_default = {
+ {DEFAULT_X_STEPS_PER_MM,DEFAULT_Y_STEPS_PER_MM,
+  DEFAULT_Z_STEPS_PER_MM,DEFAULT_A_STEPS_PER_MM},
+ {DEFAULT_X_MAX_RATE,DEFAULT_Y_MAX_RATE,
+  DEFAULT_Z_MAX_RATE,DEFAULT_A_MAX_RATE},
+ {DEFAULT_X_ACCELERATION,DEFAULT_Y_ACCELERATION,
+  DEFAULT_Z_ACCELERATION,DEFAULT_A_ACCELERATION},
+ DEFAULT_JUNCTION_DEVIATION,
+ DEFAULT_STEP_PULSE_US,
+ DEFAULT_DIR_SETUP_US,
+ DEFAULT_SPINDLE_MAX_RPM,
+ DEFAULT_SPINDLE_MIN_RPM,
+ DEFAULT_LASER_MODE,
+ {0},
+ {0}
+};
+
+//CRC-32 four bits at a time, 16 words of table instead of 256
+static const unsigned long crc_nibble[16] = {
+ 0x00000000,0x1DB71064,0x3B6E20C8,0x26D930AC,
+ 0x76DC4190,0x6B6B51F4,0x4DB26158,0x5005713C,
+ 0xEDB88320,0xF00F9344,0xD6D6A3E8,0xCB61B38C,
+ 0x9B64C2B0,0x86D3D2D4,0xA00AE278,0xBDBDF21C
+};
+
+static struct{
+ unsigned long page;       // physical base of the live page, 0 if none
+ unsigned long generation; // bumped each time the log changes page
+ unsigned int  next;       // quad index of the next free record
+}flash_log;
+
+static unsigned long crc32_words(unsigned long *w,int n){
+unsigned long crc;
+int i,j;
+  crc = 0xFFFFFFFF;
+  for(i = 0; i < n; i++){
+     crc ^= w[i];
+     for(j = 0; j < 8; j++)
+        crc = (crc >> 4) ^ crc_nibble[crc & 0x0F];
+  }
+  return ~crc;
+}
+
+#ifndef SETTINGS_NVM_STUB
+/* Unlock and start an NVM operation then wait for it, interrupts
+ * are held off for the key sequence only. The log is in the upper
+ * panel so code in the lower panel and the isrs keep running while
+ * the row is written. Returns 0 on a write or low voltage error.
+ */
+static int nvm_op(unsigned long op){
+unsigned long ie;
+  NVMCON = NVM_WREN | op;
+  ie = CP0_GET(CP0_STATUS) & 1;
+  DI();
+  NVMKEY = 0;
+  NVMKEY = 0xAA996655;
+  NVMKEY = 0x556699AA;
+  NVMCONSET = NVM_WR;
+  if(ie)
+     EI();
+  while(NVMCON & NVM_WR);
+  NVMCONCLR = NVM_WREN;
+  return (NVMCON & NVM_ERR) == 0;
+}
+
+static int flash_erase_page(unsigned long page){
+  NVMADDR = page;
+  return nvm_op(NVM_PAGE_ERASE);
+}
+
+//ECC is kept per quad word so each one is written once only
+static int flash_write_quad(unsigned long addr,unsigned long *w){
+  NVMADDR  = addr;
+  NVMDATA0 = w[0];
+  NVMDATA1 = w[1];
+  NVMDATA2 = w[2];
+  NVMDATA3 = w[3];
+  return nvm_op(NVM_QUAD_WORD);
+}
+#endif
+
+static int flash_quad_blank(unsigned long *w){
+  return (w[0] & w[1] & w[2] & w[3]) == 0xFFFFFFFF;
+}
+
+//page header is magic, generation, layout and its crc
+static int flash_page_valid(unsigned long page,unsigned long *generation){
+unsigned long *h;
+  h = FLASH_PTR(page);
+  if((h[0] != SETTINGS_MAGIC) || (h[2] != SETTINGS_LAYOUT))
+     return 0;
+  if(h[3] != crc32_words(h,3))
+     return 0;
+  *generation = h[1];
+  return 1;
+}
+
+//a record is key, value, page generation and its crc
+static int flash_write_record(unsigned long addr,int id,unsigned long generation){
+unsigned long rec[4];
+  rec[0] = SETTINGS_TAG | id;
+  rec[1] = ((unsigned long*)&settings)[id];
+  rec[2] = generation;
+  rec[3] = crc32_words(rec,3);
+  return flash_write_quad(addr,rec);
+}
+
+/* Move the log to the other page. Only settings that differ from
+ * the defaults are written, then the header goes in last so a reset
+ * part way through leaves the old page live. The old page is not
+ * erased until the log comes back round to it, each page is erased
+ * once per SETTINGS_QUADS or so writes.
+ */
+static int flash_log_compact(){
+unsigned long page,generation,rec[4];
+unsigned int next;
+int id;
+  page = (flash_log.page == SETTINGS_PAGE_0)? SETTINGS_PAGE_1 : SETTINGS_PAGE_0;
+  if(!flash_erase_page(page))
+     return 0;
+  generation = flash_log.generation + 1;
+  next = 1;
+  for(id = 0; id < SETTING_COUNT; id++){
+     if(((unsigned long*)&settings)[id] == ((unsigned long*)&settings_default)[id])
+        continue;
+     if(!flash_write_record(page + next * SETTINGS_QUAD_SIZE,id,generation))
+        return 0;
+     next++;
+  }
+  rec[0] = SETTINGS_MAGIC;
+  rec[1] = generation;
+  rec[2] = SETTINGS_LAYOUT;
+  rec[3] = crc32_words(rec,3);
+  if(!flash_write_quad(page,rec))
+     return 0;
+  flash_log.page = page;
+  flash_log.generation = generation;
+  flash_log.next = next;
+  return 1;
+}
+
+static int flash_log_append(int id){
+  if(!flash_log.page || (flash_log.next >= SETTINGS_QUADS))
+     return flash_log_compact();
+  if(!flash_write_record(flash_log.page + flash_log.next * SETTINGS_QUAD_SIZE,id,flash_log.generation)){
+     //the quad may be part written, carry the cache to a clean page
+     flash_log.next++;
+     return flash_log_compact();
+  }
+  flash_log.next++;
+  return 1;
+}
+
+//push changed values out to the modules that keep their own copy
+static void settings_apply(int id){
+  if(id < SETTING_MAX_RATE)
+     plan_update_settings();
+  else if((id == SETTING_STEP_PULSE_US) || (id == SETTING_DIR_SETUP_US))
+     st_set_pulse_timing(settings.step_pulse_us,settings.dir_setup_us);
+}
+
+/* Load the RAM copy at boot, defaults first then one pass over the
+ * records of the newest valid page with later records replacing
+ * earlier ones. Records with a bad crc were torn by a reset and are
+ * skipped. Call before Init_Steppers() so the planner and the pulse
+ * timing start from the saved values.
+ */
+void settings_init(){
+unsigned long gen_0,gen_1,*rec;
+int valid_0,valid_1;
+unsigned int i,id;
+  memcpy(&settings,&settings_default,sizeof(Settings));
+  flash_log.page = 0;
+  flash_log.generation = 0;
+  flash_log.next = 1;
+
+  valid_0 = flash_page_valid(SETTINGS_PAGE_0,&gen_0);
+  valid_1 = flash_page_valid(SETTINGS_PAGE_1,&gen_1);
+  if(valid_0 && (!valid_1 || ((long)(gen_0 - gen_1) > 0))){
+     flash_log.page = SETTINGS_PAGE_0;
+     flash_log.generation = gen_0;
+  }else if(valid_1){
+     flash_log.page = SETTINGS_PAGE_1;
+     flash_log.generation = gen_1;
+  }
+  if(!flash_log.page)
+     return;
+
+  rec = FLASH_PTR(flash_log.page);
+  for(i = 1; i < SETTINGS_QUADS; i++){
+     rec += 4;
+     if(flash_quad_blank(rec))
+        break;
+     if((rec[0] & 0xFFFF0000) != SETTINGS_TAG)
+        continue;
+     if((rec[2] != flash_log.generation) || (rec[3] != crc32_words(rec,3)))
+        continue;
+     id = rec[0] & 0xFFFF;
+     if(id < SETTING_COUNT)
+        ((unsigned long*)&settings)[id] = rec[1];
+  }
+  flash_log.next = i;
+}
+
+//back to the defaults, the log starts again on a fresh page
+void settings_restore_defaults(){
+  memcpy(&settings,&settings_default,sizeof(Settings));
+  flash_log_compact();
+  plan_update_settings();
+  st_set_pulse_timing(settings.step_pulse_us,settings.dir_setup_us);
+}
+
+/* Set one setting by id and save it, the RAM copy is used from
+ * here on even if flash fails. An unchanged value costs no flash
+ * write. Call while idle. Returns 0 if the id is out of range or
+ * the value could not be saved.
+ */
+int settings_write(int id,float value){
+unsigned long *word;
+int saved;
+  if((id < 0) || (id >= SETTING_COUNT))
+     return 0;
+  word = (unsigned long*)&settings + id;
+  if(*word == flt2ulong(value))
+     return 1;
+  *word = flt2ulong(value);
+  saved = flash_log_append(id);
+  settings_apply(id);
+  return saved;
+}
+
+//coord_select is 0..5 for G54..G59, or SETTING_INDEX_G28/G30
+int settings_read_coord_data(int coord_select,float *coord_data){
+  if((coord_select < 0) || (coord_select >= N_COORD_DATA))
+     return 0;
+  memcpy(coord_data,settings.coord_data[coord_select],sizeof(settings.coord_data[0]));
+  return 1;
+}
+
+int settings_write_coord_data(int coord_select,float *coord_data){
+int i,saved;
+  if((coord_select < 0) || (coord_select >= N_COORD_DATA))
+     return 0;
+  saved = 1;
+  for(i = 0; i < N_AXIS; i++){
+     if(!settings_write(SETTING_COORD_DATA + coord_select * N_AXIS + i,coord_data[i]))
+        saved = 0;
+  }
+  return saved;
+}
@@ -0,0 +1,92 @@
+#ifndef SETTINGS_H
+#define SETTINGS_H
+
+#include "Nuts_Bolts.h"
+#include "built_in.h"
+
+////////////////////////////////////////////////////
+//DEFINES
+//machine defaults, used until a value is saved to flash
+#define DEFAULT_X_STEPS_PER_MM 200.0f
+#define DEFAULT_Y_STEPS_PER_MM 200.0f
+#define DEFAULT_Z_STEPS_PER_MM 200.0f
+#define DEFAULT_A_STEPS_PER_MM 200.0f
+#define DEFAULT_X_MAX_RATE 3000.0f // mm/min
+#define DEFAULT_Y_MAX_RATE 3000.0f // mm/min
+#define DEFAULT_Z_MAX_RATE 1000.0f // mm/min
+#define DEFAULT_A_MAX_RATE 1000.0f // mm/min
+#define DEFAULT_X_ACCELERATION 250.0f // mm/sec^2
+#define DEFAULT_Y_ACCELERATION 250.0f // mm/sec^2
+#define DEFAULT_Z_ACCELERATION 100.0f // mm/sec^2
+#define DEFAULT_A_ACCELERATION 100.0f // mm/sec^2
+#define DEFAULT_JUNCTION_DEVIATION 0.01f // mm
+//driver timing defaults in usec
+#define DEFAULT_STEP_PULSE_US 2.5f
+#define DEFAULT_DIR_SETUP_US 5.0f
+//S word at full PWM and at the lowest PWM step
+#define DEFAULT_SPINDLE_MAX_RPM 24000.0f
+#define DEFAULT_SPINDLE_MIN_RPM 0.0f
+//1 runs the spindle output as a laser, see Spindle.h
+#define DEFAULT_LASER_MODE 0.0f
+
+//G54..G59 work offsets then the G28 and G30 positions, G92 is
+//kept in RAM only, see Gcode.h
+#define N_COORD_SYSTEM 6
+#define SETTING_INDEX_G28 N_COORD_SYSTEM
+#define SETTING_INDEX_G30 (N_COORD_SYSTEM+1)
+#define N_COORD_DATA (N_COORD_SYSTEM+2)
+//tool table for G43 H, tool 0 is no tool and always 0 long
+#define N_TOOL 16
+
+//setting ids are the 32 bit word offset of the field in Settings
+#define SETTING_STEPS_PER_MM   0
+#define SETTING_MAX_RATE       (SETTING_STEPS_PER_MM + N_AXIS)
+#define SETTING_ACCELERATION   (SETTING_MAX_RATE + N_AXIS)
+#define SETTING_JUNCTION_DEV   (SETTING_ACCELERATION + N_AXIS)
+#define SETTING_STEP_PULSE_US  (SETTING_JUNCTION_DEV + 1)
+#define SETTING_DIR_SETUP_US   (SETTING_STEP_PULSE_US + 1)
+#define SETTING_SPINDLE_MAX_RPM (SETTING_DIR_SETUP_US + 1)
+#define SETTING_SPINDLE_MIN_RPM (SETTING_SPINDLE_MAX_RPM + 1)
+#define SETTING_LASER_MODE     (SETTING_SPINDLE_MIN_RPM + 1)
+#define SETTING_COORD_DATA     (SETTING_LASER_MODE + 1)
+#define SETTING_TOOL_LENGTH    (SETTING_COORD_DATA + N_COORD_DATA*N_AXIS)
+#define SETTING_COUNT          (SETTING_TOOL_LENGTH + N_TOOL)
+//bump when the ids move, older logs are then ignored
+#define SETTINGS_VERSION 4
+
+//the log is kept in the last two 16k pages of program flash, the
+//code sits well below this in the lower panel so it keeps running
+//while the upper panel is written. Physical addresses.
+#define SETTINGS_PAGE_SIZE 0x4000
+#define SETTINGS_PAGE_0 0x1D1F8000
+#define SETTINGS_PAGE_1 0x1D1FC000
+
+////////////////////////////////////////////////////
+//STRUCTS and ENUMS
+//RAM copy of every setting, all fields are 32 bit floats so each
+//one is saved as a word by its id
+typedef struct{
+ float steps_per_mm[N_AXIS];
+ float max_rate[N_AXIS];            // mm/min
+ float acceleration[N_AXIS];        // mm/sec^2
+ float junction_deviation;          // mm
+ float step_pulse_us;
+ float dir_setup_us;
+ float spindle_max_rpm;
+ float spindle_min_rpm;
+ float laser_mode;                  // 0 or 1
+ float coord_data[N_COORD_DATA][N_AXIS]; // mm
+ float tool_length[N_TOOL];         // mm along Z
+}Settings;
+
+extern Settings settings;
+
+////////////////////////////////////////////////////
+//function prototypes
+void settings_init();
+void settings_restore_defaults();
+int  settings_write(int id,float value);
+int  settings_read_coord_data(int coord_select,float *coord_data);
+int  settings_write_coord_data(int coord_select,float *coord_data);
+
+#endif
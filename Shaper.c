@@ -0,0 +1,99 @@
+#include "Shaper.h"
+
+#ifdef INPUT_SHAPER
+//path distance per slice, convolved with up to 3 impulses
+static struct{
+float amp[3];
+float delay[3];               /* in slices */
+int n_impulse;
+float hist[SHAPER_HISTORY];
+unsigned char head;
+unsigned char quiet;          /* slices since the last movement */
+}shaper;
+#endif
+
+/* Shaper impulses for the ringing frequency in Hz and damping
+ * ratio, with K = exp(-z*pi/sqrt(1-z^2)) and Td = 1/(f*sqrt(1-z^2))
+ *   ZV   1, K             at 0, Td/2
+ *   ZVD  1, 2K, K^2       at 0, Td/2, Td
+ *   EI   (1+V)/4, (1-V)K/2, (1+V)K^2/4  at 0, Td/2, Td
+ * scaled to sum to 1 so no distance is lost. Call while idle.
+ * Returns 0 and leaves shaping off if the delay is longer than the
+ * slice history or freq is 0.
+ */
+int shaper_set(int type,float freq,float damping){
+#ifdef INPUT_SHAPER
+float k,td,sum;
+int i;
+  shaper.n_impulse = 1;
+  shaper.amp[0] = 1.0f;
+  shaper.delay[0] = 0.0f;
+  if((freq <= 0.0f) || (damping < 0.0f) || (damping >= 1.0f))
+     return 0;
+  k  = exp(-damping * M_Pi / f_sqrt(1.0f - damping * damping));
+  td = 1.0f / (freq * f_sqrt(1.0f - damping * damping));
+  if(td / SEGMENT_DT + 2.0f > SHAPER_HISTORY)
+     return 0;
+
+  switch(type){
+     case SHAPER_ZV:
+          shaper.amp[1] = k;
+          shaper.n_impulse = 2;
+          break;
+     case SHAPER_EI:
+          shaper.amp[0] = 0.25f * (1.0f + SHAPER_EI_VTOL);
+          shaper.amp[1] = 0.5f * (1.0f - SHAPER_EI_VTOL) * k;
+          shaper.amp[2] = shaper.amp[0] * k * k;
+          shaper.n_impulse = 3;
+          break;
+     default:
+          shaper.amp[1] = 2.0f * k;
+          shaper.amp[2] = k * k;
+          shaper.n_impulse = 3;
+          break;
+  }
+  sum = 0.0f;
+  for(i = 0; i < shaper.n_impulse; i++)
+     sum += shaper.amp[i];
+  for(i = 0; i < shaper.n_impulse; i++){
+     shaper.amp[i] /= sum;
+     shaper.delay[i] = 0.5f * i * td / SEGMENT_DT;
+  }
+  return 1;
+#else
+  return 0;
+#endif
+}
+
+/* Shape one SEGMENT_DT slice of path distance in place. The shaped
+ * distance is the sum of the profile's slices delayed by each
+ * impulse, a fractional delay is taken linearly between the two
+ * slices around it. Returns 0 once the profile has been still for
+ * the whole history so the shaper has run out.
+ */
+int shaper_slice(float *ds){
+#ifdef INPUT_SHAPER
+float d,f,sum;
+int i,j;
+  if(*ds > 0.0f)
+     shaper.quiet = 0;
+  else if(shaper.quiet < SHAPER_HISTORY)
+     shaper.quiet++;
+  if(shaper.quiet >= SHAPER_HISTORY)
+     return 0;
+  shaper.head = (shaper.head + 1) & (SHAPER_HISTORY-1);
+  shaper.hist[shaper.head] = *ds;
+  sum = 0.0f;
+  for(i = 0; i < shaper.n_impulse; i++){
+     d = shaper.delay[i];
+     j = (int)d;
+     f = d - j;
+     sum += shaper.amp[i] * ((1.0f - f) * shaper.hist[(shaper.head - j) & (SHAPER_HISTORY-1)] +
+                             f * shaper.hist[(shaper.head - j - 1) & (SHAPER_HISTORY-1)]);
+  }
+  *ds = sum;
+  return 1;
+#else
+  return *ds > 0.0f;
+#endif
+}
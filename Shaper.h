@@ -0,0 +1,30 @@
+#ifndef SHAPER_H
+#define SHAPER_H
+
+#include "Config.h"
+#include "built_in.h"
+
+////////////////////////////////////////////////////
+//DEFINES
+//input shaping, the path speed is convolved with the shaper
+//impulses before it is cut into steps so the gantry is not rung
+//at its resonance, comment out to step the planned profile as is
+#define INPUT_SHAPER
+#define SHAPER_ZV  0
+#define SHAPER_ZVD 1
+#define SHAPER_EI  2
+#define DEFAULT_SHAPER_TYPE SHAPER_ZVD
+#define DEFAULT_SHAPER_FREQ 40.0f    // Hz, 0 turns shaping off
+#define DEFAULT_SHAPER_DAMPING 0.1f
+#define SHAPER_EI_VTOL 0.05f         // EI residual vibration allowed
+//SEGMENT_DT slices of path speed kept, a power of 2, sets the
+//lowest shaper frequency at about 1 / (SHAPER_HISTORY*SEGMENT_DT)
+#define SHAPER_HISTORY 64
+
+
+////////////////////////////////////////////////////
+//function prototypes
+int  shaper_set(int type,float freq,float damping);
+int  shaper_slice(float *ds);
+
+#endif
@@ -0,0 +1,50 @@
+#include "Spindle.h"
+
+/* OC9 in PWM mode on TMR7 at 1:8, TMR7 has no axis on it with
+ * N_AXIS at 4. Call after Init_Axis() which sets all the axis
+ * timers up. The spindle starts off.
+ */
+void spindle_init(){
+  OC9CON = 0x0000;
+  T7CON  = 0x0000;
+  T7CON  = 0x0030;
+  PR7    = SPINDLE_PWM_PERIOD - 1;
+  TMR7   = 0;
+  OC9R   = 0;
+  OC9RS  = 0;
+  //PWM with the fault pin off, OCTSEL picks TMR7
+  OC9CON = 0x000E;
+  LATBCLR = SPINDLE_DIR_BIT;
+  OC9CONSET = 0x8000;
+  T7CONSET  = 0x8000;
+}
+
+//S word to PWM duty, min rpm is the lowest duty step and max rpm
+//is full on, 0 rpm is off
+unsigned int spindle_get_duty(float rpm){
+float range;
+  if(rpm <= 0.0f)
+     return 0;
+  range = settings.spindle_max_rpm - settings.spindle_min_rpm;
+  if((range <= 0.0f) || (rpm >= settings.spindle_max_rpm))
+     return SPINDLE_PWM_PERIOD;
+  if(rpm <= settings.spindle_min_rpm)
+     return 1;
+  return 1 + (unsigned int)((rpm - settings.spindle_min_rpm) * (SPINDLE_PWM_PERIOD - 1) / range);
+}
+
+unsigned int spindle_get_dir_lat(int state){
+  if(LASER_MODE)
+     return 0;
+  return (state == SPINDLE_CCW)? SPINDLE_DIR_BIT : 0;
+}
+
+//set the output now with the steppers stopped, a laser is turned
+//off until the next move
+void spindle_set(unsigned int duty,int state){
+unsigned int dir_lat;
+  if(LASER_MODE)
+     duty = 0;
+  dir_lat = spindle_get_dir_lat(state);
+  SPINDLE_OUT(duty,dir_lat);
+}
@@ -0,0 +1,42 @@
+#ifndef SPINDLE_H
+#define SPINDLE_H
+
+#include "Config.h"
+#include "built_in.h"
+
+////////////////////////////////////////////////////
+//DEFINES
+//spindle PWM from OC9 on TMR7, TMR7 is left over from the C axis
+//and runs at the axis timer rate
+#define SPINDLE_PWM_FREQ 1000 // Hz
+#define SPINDLE_PWM_PERIOD (AXIS_TIMER_FREQ / SPINDLE_PWM_FREQ)
+
+//M3 and M4 queue a dwell this long after turning the spindle on
+//or reversing it, comment out to run straight on
+//#define SPINDLE_SPINUP_DELAY 2.0 // secs
+
+#define SPINDLE_OFF 0
+#define SPINDLE_CW  1
+#define SPINDLE_CCW 2
+
+//in laser mode M3 is a fixed power and M4 is scaled every segment
+//by the speed over the block's nominal speed so slowing for a
+//corner does not over burn it, there is no direction pin and the
+//laser is off whenever the steppers are stopped
+#define LASER_MODE (settings.laser_mode != 0.0f)
+
+//PWM duty and direction pin, a store or two so the step isr can
+//set them as a segment or block starts, OC9RS is only taken up at
+//the end of the PWM period
+#define SPINDLE_PWM_OUT(duty) {OC9RS = (duty);}
+#define SPINDLE_DIR_OUT(dir_lat) {LATBSET = (dir_lat); LATBCLR = SPINDLE_DIR_BIT ^ (dir_lat);}
+#define SPINDLE_OUT(duty,dir_lat) {SPINDLE_PWM_OUT(duty); SPINDLE_DIR_OUT(dir_lat);}
+
+////////////////////////////////////////////////////
+//function prototypes
+void spindle_init();
+unsigned int spindle_get_duty(float rpm);
+unsigned int spindle_get_dir_lat(int state);
+void spindle_set(unsigned int duty,int state);
+
+#endif
@@ -1,162 +1,776 @@
 #include "Steppers.h"
 
-<<<<<<< HEAD
 
-=======
-void (*Dly)();
->>>>>>> 5fccbb493b943575cfd5e09931f584d18a7d5345
+
+//stepper copy of the planner block, the planner block is freed
+//as soon as its last segment is prepped. Everything the isr needs
+//is filled in here ahead of time, so starting the block in the isr
+//is a pointer swap with no arithmetic in the gap.
+typedef struct{
+unsigned long steps[MAX_AMASS_LEVEL+1][N_AXIS]; /* per amass level */
+unsigned long counter[N_AXIS];  /* Bresenham counters, preset */
+unsigned long step_event_count;
+unsigned char direction_bits;
+unsigned char axis_mask;
+unsigned char line_type;
+unsigned int dir_lat_g;  /* LATG bits set for the direction */
+unsigned int dir_lat_e;  /* LATE bits set for the direction */
+unsigned int spindle_duty;
+unsigned int spindle_dir_lat; /* LATB bit set for M4 */
+}St_Block;
+
+//constant rate slice of a block, period is in TMR8 ticks
+typedef struct{
+unsigned int n_step;
+unsigned int period;
+unsigned int spindle_duty;
+unsigned char st_block_index;
+unsigned char amass_level; /* DDA oversampled by 2^amass_level */
+}Segment;
+
+//fire a single pulse on OCn, restarting its timer TMRt from 0
+//re-arms the OCM bits so the pulse rises at OCnR, falls at OCnRS
+#define OC_PULSE(n,t) {TMR##t = 0; OC##n##CONCLR = 0x7; OC##n##CONSET = 0x4;}
 
 struct stepper{
-int xl,yl; /* starting point */
-int x2,y2; /* relative position */
-int x3,y3; /* endpoint */
-int xo,yo; /* direction of output: +1, -I, or 0 */
-int dx,dy; /* differentials of x and y */
-int stepnum;
-int fxy;
-short fm; /* value of function / fm = master [1=y%0=x]*/
+unsigned long *counter;        /* Bresenham counters of the block */
+unsigned long *steps;          /* block steps for the segment level */
+unsigned int step_count;       /* steps left in the segment */
+unsigned char exec_block_index;
+St_Block *exec_block;
+Segment *exec_segment;
+unsigned char step_outbits;
+unsigned char dir_outbits;
+char dir_wait;     /* first step of a new direction is pending */
+volatile char busy;
 };
 
-volatile static struct stepper step;
-/* vars dealing with feedrate and delay func. */
-volatile static int feedrate,drag,oil,acc_val;
-unsigned int out;
+//driver timing, pulse in axis timer ticks and dir setup in TMR8
+//ticks, min_period keeps the low time at least the pulse width
+static unsigned int pulse_ticks;
+static unsigned int dir_setup_ticks;
+static unsigned int axis_dir_setup_ticks;
+static unsigned int min_period;
+
+//only busy is shared with the main loop, the rest is owned by the
+//isr while TMR8 runs so it is not volatile and stays in registers
+static struct stepper step;
+
+//machine position in steps, only written from step interrupts,
+//position_seq is odd while a write is in progress
+volatile static long sys_position[N_AXIS];
+volatile static unsigned int position_seq;
+
+static St_Block st_block_buffer[ST_BLOCK_BUFFER_SIZE];
+static Segment segment_buffer[SEGMENT_BUFFER_SIZE];
+volatile static unsigned char segment_buffer_tail;
+static unsigned char segment_buffer_head;
+static unsigned char segment_next_head;
+
+//what is left of each stepper block to cut into segments
+typedef struct{
+unsigned long steps_remaining; /* whole steps, exact at any length */
+float step_per_mm;
+float mm_remaining;
+float dwell;                   /* G4 secs or DWELL_HOLD, no steps */
+float inv_nominal_speed;       /* laser power scale for M4 */
+char laser_dynamic;
+unsigned long raster_steps;    /* G7 scan line steps */
+unsigned long pixel_end;       /* steps_remaining as the pixel ends */
+unsigned char raster;          /* G7 pixel slot or RASTER_NONE */
+unsigned char pixel;
+unsigned char n_pixel;
+}Prep_Block;
+static Prep_Block prep_block[ST_BLOCK_BUFFER_SIZE];
+
+/* Pixel k of a scan line starts on master step k*S/N of the S steps
+ * so the N pixels are spread to the nearest step, this gives where
+ * the current pixel ends as steps still to go.
+ */
+static unsigned long prep_pixel_end(Prep_Block *pb){
+  if(pb->pixel + 1 >= pb->n_pixel)
+     return 0;
+  return pb->raster_steps - (pb->pixel + 1) * pb->raster_steps / pb->n_pixel;
+}
+
+//on to the pixel the next step is in, pixels finer than a step
+//are passed over
+static void prep_pixel_advance(Prep_Block *pb){
+  while((pb->steps_remaining == pb->pixel_end) && (pb->steps_remaining > 0)){
+     pb->pixel++;
+     pb->pixel_end = prep_pixel_end(pb);
+  }
+}
+
+//speed profile, walks the planner blocks a slice at a time
+static struct{
+unsigned char st_block_index; /* last stepper block filled */
+Block *pl_block;
+float mm_remaining;
+float current_speed;
+unsigned char direction_bits; /* of the last block, kept over a dwell */
+}cmd;
+
+//segment generator, follows the profile cutting it into steps
+static struct{
+unsigned char st_block_index; /* stepper block being cut */
+unsigned char blocks;         /* filled by cmd and not yet cut */
+float ds_left;                /* slice distance not yet used */
+float dt_left;                /* and the time it takes */
+}prep;
+
+#ifdef STEP_ISR_PROFILE
+//step isr cost in CP0 count ticks (SYSCLK/2) per line class
+static struct{
+unsigned long cycles_max[3];
+unsigned long cycles_sum[3];
+unsigned long count[3];
+}isr_prof;
+#endif
+
+//start and end points of the xy test line in steps
+static int xl,yl,x3,y3;
 
-<<<<<<< HEAD
 void Init_Steppers(){
    InitTimer8(&delay);
+   //TMR8 only runs while there are segments to step
+   T8CONCLR = 0x8000;
+   memset(&prep,0,sizeof(prep));
+   memset(&cmd,0,sizeof(cmd));
+   cmd.st_block_index = ST_BLOCK_BUFFER_SIZE-1;
+   step.exec_block_index = 0xFF;
+   step.dir_outbits = 0xFF;
+   st_set_pulse_timing(settings.step_pulse_us,settings.dir_setup_us);
+   shaper_set(DEFAULT_SHAPER_TYPE,DEFAULT_SHAPER_FREQ,DEFAULT_SHAPER_DAMPING);
+   segment_buffer_tail = segment_buffer_head = 0;
+   segment_next_head = 1;
+   plan_reset();
 }
 
-=======
->>>>>>> 5fccbb493b943575cfd5e09931f584d18a7d5345
-/* delay must remain in this position for local scope association 
- * Timer8 provides a master freq, feedate is supplied from gcode
- * drag is acc constant and oil provides a form of s curve.
+/* delay must remain in this position for local scope association
+ * Timer8 provides a master freq, called from the TMR8 isr, one
+ * DDA step event per entry at the constant rate of the current
+ * segment, no acceleration math is done here. Segments and stepper
+ * blocks hold only whole steps and timer ticks so this stays integer
+ * and never needs the FPU registers saved.
  */
-<<<<<<< HEAD
 void delay(){
-  LED2 = !LED2;
-}
-
-
-void _delay_(){
-=======
-static void delay(){
->>>>>>> 5fccbb493b943575cfd5e09931f584d18a7d5345
-static long ii;
-static int i = 0;
-static int last_drag;
- acc_val = abs((feedrate + drag) / 10);
- ii = setUsec(0);
- while (getUsec() <= (long)acc_val)continue;
-/* falls off exponentially */
- if(i < 10){
-   //if(drag > 0 || i > 489) {
-      /* drag increases the delay at the beginning */
-      /* to allow for inertia in machine startup */
-   drag = drag - (oil * oil);
-   oil--;
- }else if(i > 40){
-   ++oil;
-   drag = drag + (oil * oil);
- }
-   i++;
-   if (drag < 0) drag = 0;
+int i;
+#ifdef STEP_ISR_PROFILE
+unsigned long t0;
+  t0 = CP0_GET(CP0_COUNT);
+#endif
+#ifndef STEP_PULSE_OC
+  //end the pulse from the previous step event
+  LATDCLR = STEP_MASK_D;
+  LATFCLR = STEP_MASK_F;
+#endif
+
+  //the direction setup time has passed, back to the segment rate
+  if(step.dir_wait){
+     step.dir_wait = 0;
+     PR8 = step.exec_segment->period;
+  }
+
+  if(step.exec_segment == NULL){
+     if(segment_buffer_head == segment_buffer_tail){
+        st_go_idle();
+        return;
+     }
+     step.exec_segment = &segment_buffer[segment_buffer_tail];
+     PR8 = step.exec_segment->period;
+     step.step_count = step.exec_segment->n_step;
+     SPINDLE_PWM_OUT(step.exec_segment->spindle_duty);
+     //new block, swap to its preloaded counters and directions
+     if(step.exec_block_index != step.exec_segment->st_block_index){
+        step.exec_block_index = step.exec_segment->st_block_index;
+        step.exec_block = &st_block_buffer[step.exec_block_index];
+        step.counter = step.exec_block->counter;
+        //a direction change holds off the first step for the
+        //driver's setup time with one short TMR8 period
+        if(step.dir_outbits != step.exec_block->direction_bits){
+           step.dir_outbits = step.exec_block->direction_bits;
+           LATGSET = step.exec_block->dir_lat_g;
+           LATGCLR = DIR_MASK_G ^ step.exec_block->dir_lat_g;
+           LATESET = step.exec_block->dir_lat_e;
+           LATECLR = DIR_MASK_E ^ step.exec_block->dir_lat_e;
+           step.dir_wait = 1;
+        }
+        //an M3/M4 change queued ahead of this block, the duty is
+        //set by each segment
+        SPINDLE_DIR_OUT(step.exec_block->spindle_dir_lat);
+     }
+     //the amass level sets how many DDA ticks per master axis step
+     step.steps = step.exec_block->steps[step.exec_segment->amass_level];
+     if(step.dir_wait){
+        PR8 = dir_setup_ticks;
+        return;
+     }
+  }
+
+  if(step.exec_block->line_type == LINE_GENERAL){
+     step.step_outbits = 0;
+     for(i = 0; i < N_AXIS; i++){
+        step.counter[i] += step.steps[i];
+        if(step.counter[i] > step.exec_block->step_event_count){
+           bit_true(step.step_outbits,bit(i));
+           step.counter[i] -= step.exec_block->step_event_count;
+        }
+     }
+  }else{
+     //single axis and 45 degree lines step every moving axis
+     //on every tick, there is no error term to keep
+     step.step_outbits = step.exec_block->axis_mask;
+  }
+#ifdef STEP_PULSE_OC
+  if(step.step_outbits & bit(X_AXIS)) OC_PULSE(5,2);
+  if(step.step_outbits & bit(Y_AXIS)) OC_PULSE(2,4);
+  if(step.step_outbits & bit(Z_AXIS)) OC_PULSE(7,6);
+  if(step.step_outbits & bit(A_AXIS)) OC_PULSE(3,5);
+#else
+  LATDSET = step_lat_d[step.step_outbits];
+  LATFSET = step_lat_f[step.step_outbits];
+#endif
+
+  if(step.step_outbits){
+     position_seq++;
+     for(i = 0; i < N_AXIS; i++){
+        if(bit_istrue(step.step_outbits,bit(i))){
+           if(bit_istrue(step.dir_outbits,bit(i)))
+              sys_position[i]--;
+           else
+              sys_position[i]++;
+        }
+     }
+     position_seq++;
+  }
+
+  step.step_count--;
+  if(step.step_count == 0){
+     step.exec_segment = NULL;
+     if(++segment_buffer_tail == SEGMENT_BUFFER_SIZE)
+        segment_buffer_tail = 0;
+  }
+
+#ifdef STEP_ISR_PROFILE
+  t0 = CP0_GET(CP0_COUNT) - t0;
+  i  = step.exec_block->line_type;
+  isr_prof.cycles_sum[i] += t0;
+  isr_prof.count[i]++;
+  if(t0 > isr_prof.cycles_max[i])
+     isr_prof.cycles_max[i] = t0;
+#endif
 }
 
-void setStepXY(int _x1,int _y1,int _x3,int _y3){
-  step.xl = _x1;
-  step.yl = _y1;
-  step.x3 = _x3;
-  step.y3 = _y3;
-}
-
-void setDragOil(int _feedrate,int _drag,int _oil){
-<<<<<<< HEAD
-=======
-  Dly = delay;
->>>>>>> 5fccbb493b943575cfd5e09931f584d18a7d5345
-  feedrate = MAXFEED - _feedrate;
-  drag = _drag;
-  oil = _oil;
-}
-
-static void getdir(){
-static int rad,radrad,f,a,b,d;
-int binrep = 0;
-   step.xo = step.yo = 0;
-  if(d)binrep = binrep + 8;
-  if(f)binrep = binrep + 4;
-  if(a)binrep = binrep + 2;
-  if(b)binrep = binrep + 1;
-
-  switch(binrep){
-      case 0:  step.yo = -1; break;
-      case 1:  step.xo = -1; break;
-      case 2:  step.xo = 1;break;
-      case 3:  step.yo = 1; break;
-      case 4:  step.xo = 1;break;
-      case 5:  step.yo = -1;break;
-      case 6:  step.yo = 1; break;
-      case 7:  step.xo = -1; break;
-      case 8:  step.xo = -1; break;
-      case 9:  step.yo = 1;  break;
-      case 10: step.yo = -1;break;
-      case 11: step.xo = 1;break;
-      case 12: step.yo = 1;break;
-      case 13: step.xo = 1; break;
-      case 14: step.xo = -1; break;
-      case 15: step.yo = -1; break;
+#ifdef STEP_ISR_PROFILE
+/* Print the step isr cost per line class and clear the counts,
+ * max step rate is about SYSCLK/2 / avg cycles per step event.
+ */
+void st_isr_profile_report(){
+int i;
+  while(DMA_IsOn(1));
+  dma_printf("%s","\nLine\tSteps\tAvg\tMax\n");
+  for(i = 0; i < 3; i++){
+     while(DMA_IsOn(1));
+     dma_printf("%d\t%l\t%l\t%l\n",i,isr_prof.count[i],
+               isr_prof.count[i]? isr_prof.cycles_sum[i] / isr_prof.count[i] : 0,
+               isr_prof.cycles_max[i]);
   }
+  memset(&isr_prof,0,sizeof(isr_prof));
 }
+#endif
 
-static void setdirection(){
-                                \
-  step.dy = step.y3 - step.yl;
-  if(step.dy < 0) step.yo = -1;
-  else step.yo = 1;
-  step.dy = abs(step.dy);
+//start TMR8 if it is stopped and there is something to step
+void st_wake_up(){
+  if(step.busy || (segment_buffer_head == segment_buffer_tail))
+     return;
+  //independent axis moves own the step pins until they finish
+  if(!Axis_Release())
+     return;
+  step.busy = 1;
+  step.exec_segment = NULL;
+  //rapids may have moved the direction pins, and the buffer may
+  //have run dry part way through a block. Forget the block so the
+  //first segment reloads it and writes the direction pins and
+  //dir_outbits, which sys_position is counted by, again
+  step.exec_block_index = 0xFF;
+  step.dir_outbits = 0xFF;
+  PR8  = MIN_STEP_PERIOD;
+  TMR8 = 0;
+  T8CONSET = 0x8000;
+}
 
-  step.dx = step.x3 - step.xl;
-  if(step.dx < 0) step.xo = -1;
-  else step.xo = 1;
-  step.dx = abs(step.dx);
+void st_go_idle(){
+  T8CONCLR = 0x8000;
+  step.busy = 0;
+}
 
-  if(step.dx>step.dy){step.fxy = step.dx - step.dy;step.fm=0;}
-  else {step.fxy = step.dy - step.dx; step.fm=1;}
+//stepping, or steps are still to be cut from the path
+int st_is_busy(){
+  return step.busy || prep.blocks || (segment_buffer_head != segment_buffer_tail);
 }
 
-void doline(){
-  step.stepnum = step.x2 = step.y2 = step.fxy = 0;
-  setdirection();
-  while(DMA_IsOn(1));
-  dma_printf("%s","\nStep\tFXY\tX2\tY2\t\tXO\tYO\toutput\tacc_val\tdrag\toil\n");
-  while ( (step.dx > step.x2) && (step.dy > step.y2)){ // at endpoint?
-<<<<<<< HEAD
-     _delay_();
-=======
-     delay();
->>>>>>> 5fccbb493b943575cfd5e09931f584d18a7d5345
-     //if(!T8IE_bit){T8IE_bit = true;TMR8 =
-     out = 0;
-     if(!step.fm){
-         ++step.x2; step.fxy -= step.dy;
-         bit_true(out,bit(0));
-        if(step.fxy < 0){
-         ++step.y2; step.fxy += step.dx;
-         bit_true(out,bit(1));
+/* Consistent copy of the machine position in steps. The step
+ * interrupts bump position_seq before and after each update, so a
+ * copy taken while the sequence was unchanged and even is whole.
+ * Interrupts are never turned off, a read that was interrupted by
+ * a step is just taken again.
+ */
+void st_get_position(long *position){
+unsigned int seq;
+int i;
+  do{
+     seq = position_seq;
+     for(i = 0; i < N_AXIS; i++)
+        position[i] = sys_position[i];
+  }while((seq & 1) || (seq != position_seq));
+}
+
+//machine position in mm
+void st_get_position_mm(float *position){
+long steps[N_AXIS];
+int i;
+  st_get_position(steps);
+  for(i = 0; i < N_AXIS; i++)
+     position[i] = steps[i] / plan_get_steps_per_mm(i);
+}
+
+//steps made by the independent axis generators, called from
+//their interrupts which never run alongside the DDA
+void st_add_position(int axis,long delta){
+  position_seq++;
+  sys_position[axis] += delta;
+  position_seq++;
+}
+
+/* Driver step pulse width and direction setup time in usec. The
+ * pulse is timed by the axis OC module and the setup time by TMR8,
+ * segments are never stepped faster than twice the pulse width.
+ */
+void st_set_pulse_timing(float pulse_us,float dir_setup_us){
+unsigned int ticks;
+  pulse_ticks = (unsigned int)f_ceil(pulse_us * (AXIS_TIMER_FREQ / 1000000.0f));
+  if(pulse_ticks < 1)
+     pulse_ticks = 1;
+  dir_setup_ticks = (unsigned int)f_ceil(dir_setup_us * (STEP_TIMER_FREQ / 1000000.0f));
+  axis_dir_setup_ticks = (unsigned int)f_ceil(dir_setup_us * (AXIS_TIMER_FREQ / 1000000.0f));
+  if(dir_setup_ticks < MIN_STEP_PERIOD)
+     dir_setup_ticks = MIN_STEP_PERIOD;
+  ticks = (unsigned int)f_ceil(2 * pulse_us * (STEP_TIMER_FREQ / 1000000.0f));
+  min_period = max(ticks,MIN_STEP_PERIOD);
+  st_pulse_init();
+}
+
+unsigned int st_get_pulse_ticks(){
+  return pulse_ticks;
+}
+
+//direction setup time in axis timer ticks for the OC generators
+unsigned int st_get_axis_dir_setup_ticks(){
+  return axis_dir_setup_ticks;
+}
+
+/* Put the axis OC modules in single pulse mode for the DDA, each
+ * module is left on with OCM cleared so nothing fires until the
+ * isr arms it, the axis timers free run at 0.16us.
+ */
+void st_pulse_init(){
+#ifdef STEP_PULSE_OC
+  OC5CON = 0x0000; OC2CON = 0x0000; OC7CON = 0x0000; OC3CON = 0x0008;
+  OC5R = 1; OC5RS = 1 + pulse_ticks;
+  OC2R = 1; OC2RS = 1 + pulse_ticks;
+  OC7R = 1; OC7RS = 1 + pulse_ticks;
+  OC3R = 1; OC3RS = 1 + pulse_ticks;
+  PR2 = PR4 = PR6 = PR5 = 0xFFFF;
+  OC5IE_bit = OC2IE_bit = OC7IE_bit = OC3IE_bit = 0;
+  OC5CONSET = 0x8000; OC2CONSET = 0x8000; OC7CONSET = 0x8000; OC3CONSET = 0x8000;
+  T2CONSET  = 0x8000; T4CONSET  = 0x8000; T6CONSET  = 0x8000; T5CONSET  = 0x8000;
+#endif
+}
+
+/* Path distance covered by the planned speed profile in the next
+ * SEGMENT_DT. The speed is limited every slice by the distance left
+ * to slow down to the exit speed, so the look ahead may raise the
+ * exit speed while the block is being sliced. A slice runs on into
+ * the next block when one ends part way through, each block started
+ * is copied for the isr and handed on to the segment generator.
+ */
+static float prep_cmd_slice(){
+St_Block *st_block;
+Prep_Block *pb;
+float v0,v1,ds,dt,s,exit_speed_sqr,mm;
+int i,j;
+
+  dt = SEGMENT_DT;
+  mm = 0.0f;
+  while(dt > 0.0f){
+     if(cmd.pl_block == NULL){
+        //the segment generator is too far behind to take another
+        if(prep.blocks >= PREP_MAX_BLOCKS)
+           break;
+        cmd.pl_block = plan_get_current_block();
+        if(cmd.pl_block == NULL)
+           break;
+        //copy what the isr needs, the planner block may be reused
+        if(++cmd.st_block_index == ST_BLOCK_BUFFER_SIZE)
+           cmd.st_block_index = 0;
+        st_block = &st_block_buffer[cmd.st_block_index];
+        //block steps are held at the max level, each amass level
+        //is the same steps shifted down by the level
+        st_block->step_event_count = cmd.pl_block->step_event_count << MAX_AMASS_LEVEL;
+        for(i = 0; i < N_AXIS; i++){
+           for(j = 0; j <= MAX_AMASS_LEVEL; j++)
+              st_block->steps[j][i] = (cmd.pl_block->steps[i] << MAX_AMASS_LEVEL) >> j;
+           st_block->counter[i] = st_block->step_event_count >> 1;
+        }
+        //a dwell leaves the direction pins where they are
+        if(cmd.pl_block->dwell == 0.0f)
+           cmd.direction_bits = cmd.pl_block->direction_bits;
+        st_block->direction_bits = cmd.direction_bits;
+        st_block->axis_mask = cmd.pl_block->axis_mask;
+        st_block->line_type = cmd.pl_block->line_type;
+        st_block->dir_lat_g = dir_lat_g[st_block->direction_bits];
+        st_block->dir_lat_e = dir_lat_e[st_block->direction_bits];
+        st_block->spindle_duty = cmd.pl_block->spindle_duty;
+        st_block->spindle_dir_lat = spindle_get_dir_lat(cmd.pl_block->spindle_state);
+
+        pb = &prep_block[cmd.st_block_index];
+        pb->steps_remaining = cmd.pl_block->step_event_count;
+        pb->mm_remaining = cmd.pl_block->millimeters;
+        pb->dwell = cmd.pl_block->dwell;
+        if(pb->dwell == 0.0f)
+           pb->step_per_mm = (float)pb->steps_remaining / pb->mm_remaining;
+        pb->laser_dynamic = LASER_MODE && (cmd.pl_block->spindle_state == SPINDLE_CCW);
+        if(cmd.pl_block->nominal_speed_sqr > 0.0f)
+           pb->inv_nominal_speed = f_rsqrt(cmd.pl_block->nominal_speed_sqr);
+        pb->raster = cmd.pl_block->raster;
+        if(pb->raster != RASTER_NONE){
+           pb->raster_steps = pb->steps_remaining;
+           pb->n_pixel = raster_get_count(pb->raster);
+           pb->pixel = 0;
+           pb->pixel_end = prep_pixel_end(pb);
+           prep_pixel_advance(pb);
         }
-     }else{
-         ++step.y2; step.fxy -= step.dx;
-         bit_true(out,bit(1));
-       if(step.fxy < 0){
-         ++step.x2;step.fxy += step.dy;
-         bit_true(out,bit(0));
-       }
+        prep.blocks++;
+        cmd.mm_remaining = cmd.pl_block->millimeters;
+        //current_speed carries over, the last block ended at the
+        //exit speed it was sliced to, which is this entry speed
      }
-     while(DMA_IsOn(1));
-     dma_printf("\n%d\t%d\t%d\t%d\t\t%d\t%d\t%d\t%d\t%d\t%d"
-               ,step.stepnum++,step.fxy,step.x2,
-               step.y2,step.xo,step.yo,out,acc_val,drag,oil);
+
+     if(cmd.pl_block->dwell != 0.0f){
+        //the profile waits at rest until the dwell has been cut,
+        //it is the last block filled so none are left when it is
+        cmd.current_speed = 0.0f;
+        if(prep.blocks)
+           break;
+        plan_discard_current_block();
+        cmd.pl_block = NULL;
+        continue;
+     }
+
+     exit_speed_sqr = plan_get_exec_block_exit_speed_sqr();
+     v0 = cmd.current_speed;
+     v1 = v0 + cmd.pl_block->acceleration * dt;
+     if(v1 * v1 > cmd.pl_block->nominal_speed_sqr)
+        v1 = f_sqrt(cmd.pl_block->nominal_speed_sqr);
+     //fastest speed that can still slow to the exit speed
+     s = cmd.mm_remaining - v0 * dt;
+     if(s > 0.0f)
+        s = f_sqrt(exit_speed_sqr + 2 * cmd.pl_block->acceleration * s);
+     else
+        s = f_sqrt(exit_speed_sqr);
+     if(v1 > s)
+        v1 = s;
+     ds = 0.5f * (v0 + v1) * dt;
+     cmd.current_speed = v1;
+
+     if((ds >= cmd.mm_remaining) || (ds <= 0.0f)){
+        //end of the block, the rest of the slice goes to the next
+        if(ds > 0.0f)
+           dt -= dt * cmd.mm_remaining / ds;
+        else
+           dt = 0.0f;
+        mm += cmd.mm_remaining;
+        //never carry more than the planned exit speed over
+        if(cmd.current_speed * cmd.current_speed > exit_speed_sqr)
+           cmd.current_speed = f_sqrt(exit_speed_sqr);
+        plan_discard_current_block();
+        cmd.pl_block = NULL;
+        continue;
+     }
+     cmd.mm_remaining -= ds;
+     mm += ds;
+     dt = 0.0f;
+  }
+  return mm;
+}
+
+/* Next slice of path for the segment generator, passed through the
+ * input shaper. Returns 0 once the profile has stopped and the
+ * shaper has run out.
+ */
+static char prep_next_slice(){
+float ds;
+  ds = prep_cmd_slice();
+#ifdef INPUT_SHAPER
+  if(!shaper_slice(&ds))
+     return 0;
+#else
+  if(ds <= 0.0f)
+     return 0;
+#endif
+  prep.ds_left = ds;
+  prep.dt_left = SEGMENT_DT;
+  return 1;
+}
+
+/* The path before a dwell has been cut, fill the next segment with
+ * the dwell time and no steps. TMR8 runs on through it so the path
+ * starts again on time from the isr and not when the main loop gets
+ * round to it. An M0 hold fills nothing, the stepper runs dry and
+ * stops until st_cycle_start(). Returns 0 while held.
+ */
+static char prep_dwell_segment(){
+Segment *prep_segment;
+St_Block *st_block;
+float ticks;
+unsigned long n;
+  if(prep_block[prep.st_block_index].dwell < 0.0f){
+     //stepping has stopped at the hold, an M5 before the M0 has
+     //no block of its own to start so it is set here
+     if(!step.busy && (segment_buffer_head == segment_buffer_tail)){
+        st_block = &st_block_buffer[prep.st_block_index];
+        SPINDLE_OUT(LASER_MODE? 0 : st_block->spindle_duty,st_block->spindle_dir_lat);
+     }
+     return 0;
   }
-}
\ No newline at end of file
+  ticks = prep_block[prep.st_block_index].dwell * STEP_TIMER_FREQ;
+  n = (unsigned long)(ticks / MAX_STEP_PERIOD) + 1;
+  prep_segment = &segment_buffer[segment_buffer_head];
+  prep_segment->st_block_index = prep.st_block_index;
+  prep_segment->amass_level = 0;
+  //a laser at M4 power has no speed to burn at while it waits
+  prep_segment->spindle_duty = prep_block[prep.st_block_index].laser_dynamic?
+                               0 : st_block_buffer[prep.st_block_index].spindle_duty;
+  prep_segment->n_step = n;
+  prep_segment->period = max((unsigned long)(ticks / n),min_period);
+
+  prep.blocks--;
+  if(++prep.st_block_index == ST_BLOCK_BUFFER_SIZE)
+     prep.st_block_index = 0;
+  segment_buffer_head = segment_next_head;
+  if(++segment_next_head == SEGMENT_BUFFER_SIZE)
+     segment_next_head = 0;
+  return 1;
+}
+
+/* Cycle start, lets the path run on past an M0 hold once the path
+ * up to it has been cut. Returns 0 if the path is not held there.
+ */
+int st_cycle_start(){
+  if(!st_is_held())
+     return 0;
+  prep.blocks--;
+  if(++prep.st_block_index == ST_BLOCK_BUFFER_SIZE)
+     prep.st_block_index = 0;
+  return 1;
+}
+
+//the segment generator has reached an M0 hold
+int st_is_held(){
+  return prep.blocks && (prep_block[prep.st_block_index].dwell < 0.0f);
+}
+
+/* Segment generator, called from the main loop to keep the segment
+ * buffer full. Each segment takes slices of the path until it holds
+ * a whole number of steps, and runs them at one period. A segment
+ * ends with its block and the rest of the slice starts the next.
+ */
+void st_prep_buffer(){
+Segment *prep_segment;
+Prep_Block *pb;
+float dt,mm_seg,mm_left,power,f;
+unsigned long steps_after;
+unsigned long n_step,period,cut;
+unsigned char pixel;
+char last,idle;
+
+  while(segment_buffer_tail != segment_next_head){
+
+     dt = 0.0f;
+     mm_seg = 0.0f;
+     n_step = 0;
+     last = 0;
+     idle = 0;
+     while(1){
+        if(prep.dt_left <= 0.0f){
+           if(!prep_next_slice()){
+              idle = 1;
+              break;
+           }
+        }
+        if(prep.blocks == 0){
+           //rounding left a sliver of path past the last block
+           prep.dt_left = 0.0f;
+           continue;
+        }
+        pb = &prep_block[prep.st_block_index];
+        //a dwell is reached once the path before it is all cut
+        if(pb->dwell != 0.0f)
+           break;
+        mm_left = pb->mm_remaining - mm_seg;
+        if(prep.ds_left >= mm_left){
+           //end of the block, only time the part of the slice used
+           if(prep.ds_left > 0.0f){
+              dt += prep.dt_left * mm_left / prep.ds_left;
+              prep.dt_left -= prep.dt_left * mm_left / prep.ds_left;
+           }
+           prep.ds_left -= mm_left;
+           mm_seg = pb->mm_remaining;
+           n_step = pb->steps_remaining;
+           last = 1;
+           break;
+        }
+        mm_seg += prep.ds_left;
+        dt += prep.dt_left;
+        prep.ds_left = 0.0f;
+        prep.dt_left = 0.0f;
+        steps_after = (unsigned long)f_ceil((pb->mm_remaining - mm_seg) * pb->step_per_mm);
+        n_step = (steps_after < pb->steps_remaining)? pb->steps_remaining - steps_after : 0;
+        if((n_step > 0) || (dt >= SEGMENT_DT_MAX))
+           break;
+     }
+
+     if(prep.blocks && (prep_block[prep.st_block_index].dwell != 0.0f)){
+        if(!prep_dwell_segment())
+           return;
+        continue;
+     }
+
+     if(idle){
+        //the path has stopped, anything rounding left in the block
+        //is stepped out now. With nothing left a spindle change
+        //with no move after it is set once the last step is made
+        if(prep.blocks == 0){
+           if(!step.busy && (segment_buffer_head == segment_buffer_tail))
+              spindle_set(plan_get_spindle_duty(),plan_get_spindle_state());
+           return;
+        }
+        pb = &prep_block[prep.st_block_index];
+        n_step = pb->steps_remaining;
+        if(dt <= 0.0f)
+           dt = SEGMENT_DT;
+        last = 1;
+     }
+
+     prep_segment = &segment_buffer[segment_buffer_head];
+     prep_segment->st_block_index = prep.st_block_index;
+     if(n_step == 0)
+        n_step = 1;
+     if(n_step > pb->steps_remaining)
+        n_step = pb->steps_remaining;
+     //a scan line segment ends where its pixel does so the power
+     //changes on the step, the rest of the path goes back to the slice
+     pixel = 0;
+     if(pb->raster != RASTER_NONE){
+        pixel = raster_get_pixels(pb->raster)[pb->pixel];
+        cut = pb->steps_remaining - pb->pixel_end;
+        if(n_step > cut){
+           f = (float)cut / n_step;
+           if(!idle){
+              prep.ds_left += mm_seg * (1.0f - f);
+              prep.dt_left += dt * (1.0f - f);
+           }
+           mm_seg *= f;
+           dt *= f;
+           n_step = cut;
+           last = 0;
+        }
+     }
+     pb->steps_remaining -= n_step;
+     pb->mm_remaining -= mm_seg;
+     if(pb->raster != RASTER_NONE)
+        prep_pixel_advance(pb);
+
+     period = (unsigned long)(dt * STEP_TIMER_FREQ / n_step);
+     //at low step rates run the DDA 2^level times faster so the
+     //minor axis steps fall evenly between the master axis steps
+     #ifdef AMASS
+     if(period < AMASS_LEVEL1)
+        prep_segment->amass_level = 0;
+     else if(period < AMASS_LEVEL2)
+        prep_segment->amass_level = 1;
+     else if(period < AMASS_LEVEL3)
+        prep_segment->amass_level = 2;
+     else
+        prep_segment->amass_level = MAX_AMASS_LEVEL;
+     #else
+     prep_segment->amass_level = 0;
+     #endif
+     //fast path lines step every tick, nothing to smooth
+     if(st_block_buffer[prep.st_block_index].line_type != LINE_GENERAL)
+        prep_segment->amass_level = 0;
+     n_step <<= prep_segment->amass_level;
+     period >>= prep_segment->amass_level;
+     if(period < min_period)
+        period = min_period;
+     if(period > MAX_STEP_PERIOD)
+        period = MAX_STEP_PERIOD;
+     prep_segment->n_step = n_step;
+     prep_segment->period = period;
+
+     //M4 laser power follows the speed the segment runs at
+     prep_segment->spindle_duty = st_block_buffer[prep.st_block_index].spindle_duty;
+     if(pb->raster != RASTER_NONE)
+        prep_segment->spindle_duty = (unsigned int)(((unsigned long)prep_segment->spindle_duty * pixel) / 255);
+     if(pb->laser_dynamic){
+        power = (dt > 0.0f)? mm_seg * pb->inv_nominal_speed / dt : 0.0f;
+        if(power < 1.0f)
+           prep_segment->spindle_duty = (unsigned int)(prep_segment->spindle_duty * power);
+     }
+
+     if(last || (pb->steps_remaining == 0)){
+        if(pb->raster != RASTER_NONE)
+           raster_release();
+        prep.blocks--;
+        if(++prep.st_block_index == ST_BLOCK_BUFFER_SIZE)
+           prep.st_block_index = 0;
+     }
+
+     segment_buffer_head = segment_next_head;
+     if(++segment_next_head == SEGMENT_BUFFER_SIZE)
+        segment_next_head = 0;
+  }
+}
+
+void setStepXY(int _x1,int _y1,int _x3,int _y3){
+  xl = _x1;
+  yl = _y1;
+  x3 = _x3;
+  y3 = _y3;
+}
+
+/* Queue the xy test line relative to the planned position,
+ * the move is stepped by TMR8 while the main loop keeps the
+ * segment buffer topped up.
+ */
+void doline(){
+float target[N_AXIS];
+char x_str[14],y_str[14];
+  plan_get_position(target);
+  target[X_AXIS] += (x3 - xl) / plan_get_steps_per_mm(X_AXIS);
+  target[Y_AXIS] += (y3 - yl) / plan_get_steps_per_mm(Y_AXIS);
+  while(plan_check_full_buffer())
+     st_prep_buffer();
+  if(!plan_buffer_line(target,DEFAULT_FEEDRATE))
+     return;
+  st_prep_buffer();
+  st_wake_up();
+
+  st_get_position_mm(target);
+  q16_to_str(flt2q16(target[X_AXIS]),x_str,3);
+  q16_to_str(flt2q16(target[Y_AXIS]),y_str,3);
+  while(DMA_IsOn(1));
+  dma_printf("\nBlocks\t%d\tMPos\t%s\t%s\n",plan_get_block_buffer_count(),
+             x_str,y_str);
+}
@@ -6,25 +6,63 @@
 #include "Timers.h"
 #include "Serial_Dma.h"
 #include "Nuts_Bolts.h"
+#include "Planner.h"
+#include "Axis.h"
 #include "built_in.h"
 
 
-#define MAXFEED 180
-<<<<<<< HEAD
+//TMR8 is the step timer, PBCLK3 50MHz / 32 = 0.64us tick
+#define STEP_TIMER_FREQ 1562500
+//shortest and longest step period allowed in TMR8 ticks
+#define MIN_STEP_PERIOD 16
+#define MAX_STEP_PERIOD 0xFFFF
+
+//segment generator, each planned block is sliced into segments
+//of SEGMENT_DT seconds with a constant step rate in each one
+#define SEGMENT_BUFFER_SIZE 8
+#define SEGMENT_DT 0.0015f
+//a segment is stretched up to this long to hold at least 1 step
+#define SEGMENT_DT_MAX 0.05f
+//blocks the speed profile may run ahead of the steps, covers the
+//shaper delay over runs of short moves
+#define PREP_MAX_BLOCKS 24
+#define ST_BLOCK_BUFFER_SIZE (SEGMENT_BUFFER_SIZE + PREP_MAX_BLOCKS)
+
+//step pulses come from the axis OC modules in dual compare
+//single pulse mode so the pulse ends in hardware, comment out
+//to drive the step pins from LATx in the isr
+#define STEP_PULSE_OC
+
+//adaptive multi axis step smoothing, comment out to turn off
+#define AMASS
+//step periods above these run the DDA at 2x, 4x and 8x
+#define MAX_AMASS_LEVEL 3
+#define AMASS_LEVEL1 (STEP_TIMER_FREQ/8000)
+#define AMASS_LEVEL2 (STEP_TIMER_FREQ/4000)
+#define AMASS_LEVEL3 (STEP_TIMER_FREQ/2000)
+
+//time the step isr per line class with the CP0 count register
+//#define STEP_ISR_PROFILE
+
 void Init_Steppers();
 void delay();
-=======
-
-//static void delay();
->>>>>>> 5fccbb493b943575cfd5e09931f584d18a7d5345
 void setStepXY(int _x1,int _y1,int _x3,int _y3);
-void setDragOil(int _feedrate,int _drag,int _oil);
-void doline();
-/*
-void getdir();
-void delay();
-void setdirection();
 void doline();
-*/
+void st_prep_buffer();
+void st_wake_up();
+void st_go_idle();
+int  st_is_busy();
+int  st_cycle_start();
+int  st_is_held();
+void st_get_position(long *position);
+void st_get_position_mm(float *position);
+void st_add_position(int axis,long delta);
+void st_set_pulse_timing(float pulse_us,float dir_setup_us);
+unsigned int st_get_pulse_ticks();
+unsigned int st_get_axis_dir_setup_ticks();
+void st_pulse_init();
+#ifdef STEP_ISR_PROFILE
+void st_isr_profile_report();
+#endif
 
-#endif
\ No newline at end of file
+#endif
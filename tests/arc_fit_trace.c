@@ -0,0 +1,83 @@
+//Feeds CAM style chorded half circles through the ARC_FIT stage of
+//Motion.c and counts the lines that reach the planner
+#include "host.h"
+#include "../Nuts_Bolts.h"
+#include "../Planner.h"
+
+#define SPINDLE_OFF 0
+#define LASER_MODE  0
+#define RASTER_NONE 0xFF
+unsigned int spindle_get_duty(float rpm){ return 0; }
+void st_prep_buffer(){}
+void st_wake_up(){}
+int  st_is_busy(){ return 0; }
+int  st_is_held(){ return 0; }
+
+static float queue_end[N_AXIS];
+static float centre[2],radius,max_error;
+static int blocks;
+
+int plan_buffer_line(float *target,float feed_rate){
+float dx,dy,mx,my,e;
+  //chord ends and middles measured against the true circle
+  dx = target[X_AXIS] - centre[0];
+  dy = target[Y_AXIS] - centre[1];
+  mx = 0.5 * (target[X_AXIS] + queue_end[X_AXIS]) - centre[0];
+  my = 0.5 * (target[Y_AXIS] + queue_end[Y_AXIS]) - centre[1];
+  e = max(fabs(sqrt(dx * dx + dy * dy) - radius),fabs(sqrt(mx * mx + my * my) - radius));
+  max_error = max(max_error,e);
+  memcpy(queue_end,target,sizeof(queue_end));
+  blocks++;
+  return 1;
+}
+int  plan_buffer_dwell(float seconds){ return 1; }
+void plan_set_spindle(int state,unsigned int duty){}
+int  plan_get_spindle_state(){ return 0; }
+unsigned int plan_get_spindle_duty(){ return 0; }
+void plan_set_raster(int slot){}
+int  plan_check_full_buffer(){ return 0; }
+Block *plan_get_current_block(){ return NULL; }
+float plan_get_max_rate(int axis){ return 3000.0; }
+long plan_mm_to_steps(float mm,int axis){ return lround(mm * 100.0); }
+float plan_get_acceleration(int axis){ return 250.0; }
+void plan_get_position(float *position){ memcpy(position,queue_end,sizeof(queue_end)); }
+
+#include "../Nut_Bolts.c"
+#include "../Motion.c"
+
+int main(){
+const float tol[3] = {0.001,0.002,0.005};
+const float rad[4] = {2.0,5.0,10.0,25.0};
+float target[N_AXIS],a;
+int i,j,k,lines;
+  printf("half circles, CAM chord tol -> lines in, blocks out, max error mm\n");
+  for(i = 0; i < 3; i++){
+     for(j = 0; j < 4; j++){
+        radius = rad[j];
+        centre[0] = radius;
+        centre[1] = 0.0;
+        memset(queue_end,0,sizeof(queue_end));
+        memset(target,0,sizeof(target));
+        lines = (int)ceil(M_PI / (2.0 * acos(1.0 - tol[i] / radius)));
+        blocks = 0;
+        max_error = 0.0;
+        for(k = 1; k <= lines; k++){
+           a = M_PI - M_PI * k / lines;
+           target[X_AXIS] = centre[0] + radius * cos(a);
+           target[Y_AXIS] = centre[1] + radius * sin(a);
+           mc_line(target,1000.0);
+        }
+        mc_flush();
+        printf("r %5.1f tol %.3f  %4d -> %4d  %.4f\n",radius,tol[i],lines,blocks,max_error);
+        //ends where the program does, within the fit tolerance
+        CHECK(fabs(queue_end[X_AXIS] - target[X_AXIS]) < 1e-4);
+        CHECK(fabs(queue_end[Y_AXIS] - target[Y_AXIS]) < 1e-4);
+        CHECK(max_error < ARC_FIT_TOLERANCE + tol[i] + 1e-4);
+        CHECK(blocks <= lines);
+        //runs chorded finer than the fit tolerance must shrink
+        if(i < 2)
+           CHECK(blocks < lines);
+     }
+  }
+  return host_failures != 0;
+}
@@ -0,0 +1,191 @@
+//Gcode.c parser, lines in and the motion calls they make out
+#include "host.h"
+#include "../Nuts_Bolts.h"
+#include "../Settings.h"
+#define INDEPENDENT_RAPIDS
+#include "../Motion.h"
+
+#define SPINDLE_OFF 0
+#define SPINDLE_CW  1
+#define SPINDLE_CCW 2
+#define DWELL_HOLD (-1.0)
+
+Settings settings;
+
+//the last motion call
+static char last_call;
+static float last_target[N_AXIS],last_feed,last_arg;
+static int n_calls,rapid_refused;
+
+static void record(char call,float *target,float feed,float arg){
+  last_call = call;
+  if(target)
+     memcpy(last_target,target,sizeof(last_target));
+  last_feed = feed;
+  last_arg = arg;
+  n_calls++;
+}
+
+void mc_line(float *target,float feed_rate){ record('L',target,feed_rate,0.0); }
+//a refused rapid is queued on the planner as a line
+int  mc_rapid(float *target){
+  if(rapid_refused)
+     return 0;
+  record('G',target,0.0,0.0);
+  return 1;
+}
+void mc_arc(float *target,float *offset,float radius,float feed_rate,
+            int is_clockwise,int axis_0,int axis_1){ record(is_clockwise? 'C' : 'A',target,feed_rate,radius); }
+void mc_spline(float *target,float *offset_1,float *offset_2,float feed_rate){ record('S',target,feed_rate,offset_2[1]); }
+void mc_dwell(float seconds){ record('D',NULL,0.0,seconds); }
+void mc_spindle(int state,float rpm){ record('M',NULL,rpm,state); }
+void mc_set_path_blending(float tolerance){ record('B',NULL,0.0,tolerance); }
+int  raster_line(float *start,float *target,float feed_rate,float rpm,char *data){
+  //the programmed start, where the last block left off
+  CHECK(memcmp(start,last_target,sizeof(last_target)) == 0);
+  if(strcmp(data,"AP8A") != 0)
+     return 0;
+  record('R',target,feed_rate,rpm);
+  return 1;
+}
+void mc_flush(){}
+void mc_synchronize(){}
+void plan_get_position(float *position){ memcpy(position,last_target,sizeof(last_target)); }
+int  settings_read_coord_data(int coord_select,float *coord_data){
+  memcpy(coord_data,settings.coord_data[coord_select],N_AXIS * sizeof(float));
+  return 1;
+}
+int  settings_write_coord_data(int coord_select,float *coord_data){
+  memcpy(settings.coord_data[coord_select],coord_data,N_AXIS * sizeof(float));
+  return 1;
+}
+int  settings_write(int id,float value){
+  ((float *)&settings)[id] = value;
+  return 1;
+}
+
+#include "../Nut_Bolts.c"
+#include "../Gcode.c"
+
+//runs a line and checks it made the call given, with the last
+//target at x y z, call 0 is no call
+static void run_with(int (*execute)(char *),char *line,int ok,char call,float x,float y,float z){
+int n;
+  n = n_calls;
+  CHECK(execute(line) == ok);
+  if(!ok || !call){
+     if(n_calls != n)
+        printf("  %s\n",line);
+     CHECK(n_calls == n);
+     return;
+  }
+  if((last_call != call) || (fabs(last_target[X_AXIS] - x) > 1e-5) ||
+     (fabs(last_target[Y_AXIS] - y) > 1e-5) || (fabs(last_target[Z_AXIS] - z) > 1e-5))
+     printf("  %s -> %c %g %g %g\n",line,last_call,last_target[X_AXIS],
+            last_target[Y_AXIS],last_target[Z_AXIS]);
+  CHECK(last_call == call);
+  CHECK(fabs(last_target[X_AXIS] - x) <= 1e-5);
+  CHECK(fabs(last_target[Y_AXIS] - y) <= 1e-5);
+  CHECK(fabs(last_target[Z_AXIS] - z) <= 1e-5);
+}
+
+static void run(char *line,int ok,char call,float x,float y,float z){
+  run_with(gc_execute_line,line,ok,call,x,y,z);
+}
+
+//what follows $J=
+static void jog(char *line,int ok,char call,float x,float y,float z){
+  run_with(gc_execute_jog,line,ok,call,x,y,z);
+}
+
+int main(){
+  settings.coord_data[1][X_AXIS] = 100.0;   //G55
+  settings.tool_length[2] = 5.0;
+  gc_init();
+
+  //words run together, lower case and comments
+  run("G1X10Y5F600",1,'L',10.0,5.0,0.0);
+  CHECK(last_feed == 600.0);
+  run("x20 (comment y99) y-2.5 ; z7",1,'L',20.0,-2.5,0.0);
+  run("G0 Z3",1,'G',20.0,-2.5,3.0);
+  rapid_refused = 1;
+  run("Z3.5",1,'L',20.0,-2.5,3.5);
+  CHECK(last_feed == RAPID_FEED_RATE);
+  rapid_refused = 0;
+  run("Z3",1,'G',20.0,-2.5,3.0);
+  //incremental, then back to absolute
+  run("G91 G1 X1 Y1",1,'L',21.0,-1.5,3.0);
+  run("G90 X0",1,'L',0.0,-1.5,3.0);
+  //work offsets, G55 and G43 H2 are added, G53 is machine coords
+  run("G55 X1",1,'L',101.0,-1.5,3.0);
+  run("G43 H2 Z0",1,'L',101.0,-1.5,5.0);
+  run("G53 G0 X0",1,'G',0.0,-1.5,5.0);
+  run("G49 G54 Z0",1,'G',0.0,-1.5,0.0);
+  //G92 takes the axis words and does not move
+  run("G92 X50",1,0,0,0,0);
+  run("X60",1,'G',10.0,-1.5,0.0);
+  run("G92.1 X60",1,'G',60.0,-1.5,0.0);
+  //arcs and splines
+  run("G2 X70 Y8.5 I5 J5",1,'C',70.0,8.5,0.0);
+  CHECK(fabs(last_arg - sqrt(50.0)) < 1e-5);
+  run("G3 X60 I-5",1,'A',60.0,8.5,0.0);
+  run("G3 X50",0,0,0,0,0);
+  run("G5 X40 I1 J1 P-1 Q2",1,'S',40.0,8.5,0.0);
+  CHECK(last_arg == 2.0);
+  run("G5 X40 I1 J1 P-1",0,0,0,0,0);
+  //dwell, blending and stops
+  run("G4 P0.5",1,'D',40.0,8.5,0.0);
+  CHECK(last_arg == (float)0.5);
+  run("G4",0,0,0,0,0);
+  run("G64 P0.02",1,'B',40.0,8.5,0.0);
+  run("M0",1,'D',40.0,8.5,0.0);
+  CHECK(last_arg == DWELL_HOLD);
+  //spindle changes, S alone is only queued while it turns
+  run("M3 S1000",1,'M',40.0,8.5,0.0);
+  CHECK((last_arg == SPINDLE_CW) && (last_feed == 1000.0));
+  run("s2000",1,'M',40.0,8.5,0.0);
+  CHECK((last_arg == SPINDLE_CW) && (last_feed == 2000.0));
+  run("M4",1,'M',40.0,8.5,0.0);
+  CHECK((last_arg == SPINDLE_CCW) && (last_feed == 2000.0));
+  run("M5",1,'M',40.0,8.5,0.0);
+  CHECK(last_arg == SPINDLE_OFF);
+  run("S500",1,0,0,0,0);
+  run("S-1",0,0,0,0,0);
+  //G7 with the words run together, S is for the line only
+  run("G7X45Y9F300S800DAP8A",1,'R',45.0,9.0,0.0);
+  CHECK((last_feed == 300.0) && (last_arg == 800.0));
+  CHECK(gc.spindle_speed == 500.0);
+  run("G7 X40 DAP8A",1,'R',40.0,9.0,0.0);
+  CHECK(last_arg == 500.0);
+  run("G7 X45 Dzz",0,0,0,0,0);
+  CHECK(gc.position[X_AXIS] == 40.0);
+  run("G7 X45",0,0,0,0,0);
+  run("X45 DAP8A",0,0,0,0,0);
+  run("G0 X40 Y8.5",1,'G',40.0,8.5,0.0);
+  //jogs are from the machine position in G91 and G55 alike
+  run("G91 G55",1,0,0,0,0);
+  jog("X1 y-0.5",1,'G',41.0,8.0,0.0);
+  CHECK((gc.position[X_AXIS] == 41.0) && (gc.position[Y_AXIS] == 8.0));
+  jog("Z-2",1,'G',41.0,8.0,-2.0);
+  jog("X1 X1",0,0,0,0,0);
+  jog("G1 X1",0,0,0,0,0);
+  jog("F100 X1",0,0,0,0,0);
+  jog("",0,0,0,0,0);
+  run("G90 G54 G0 X40 Y8.5 Z0",1,'G',40.0,8.5,0.0);
+  run("G1 F600",1,0,0,0,0);
+  //bad words
+  run("G1 X1 Y",0,0,0,0,0);
+  run("G20 X1",0,0,0,0,0);
+  run("G4 G92 P1",0,0,0,0,0);
+  run("T1",0,0,0,0,0);
+  run("#1=2",0,0,0,0,0);
+  //M2 back to G1, G54, feed is kept
+  run("M2",1,'M',40.0,8.5,0.0);
+  CHECK(last_arg == SPINDLE_OFF);
+  CHECK(gc.motion_mode == MOTION_MODE_LINEAR);
+  CHECK(gc.program_flow == PROGRAM_FLOW_COMPLETED);
+  run("X0 Y0",1,'L',0.0,0.0,0.0);
+  CHECK(last_feed == 600.0);
+  printf("gcode lines %s\n",host_failures? "failed" : "ok");
+  return host_failures != 0;
+}
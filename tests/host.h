@@ -0,0 +1,25 @@
+#ifndef HOST_H
+#define HOST_H
+
+//Host build of single firmware modules for the tests in this
+//directory. Config.h pulls in the PIC32 register headers, so its
+//guard is set here and each test includes what its module needs.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdint.h>
+
+#define CONFIG_H
+//mikroC has no libm round/lround, the firmware ones take floats
+#define round  fw_round
+#define lround fw_lround
+//mikroC longs are 32 bit like an int, the host's are 64
+#define long int
+
+static int host_failures;
+
+#define CHECK(cond) do{ if(!(cond)){ host_failures++; \
+   printf("%s:%d: CHECK(%s) failed\n",__FILE__,__LINE__,#cond); } }while(0)
+
+#endif
@@ -0,0 +1,190 @@
+//Nut_Bolts.c maths against the host libm in double
+#include "host.h"
+#include "../Nuts_Bolts.h"
+#include "../Nut_Bolts.c"
+
+//largest error of f over [lo,hi] in n even steps
+static double max_error(float (*f)(float),double (*ref)(double),double lo,double hi,int n){
+double e,worst;
+float x;
+int i;
+  worst = 0.0;
+  for(i = 0; i <= n; i++){
+     x = (float)(lo + (hi - lo) * i / n);
+     e = fabs((double)f(x) - ref((double)x));
+     if(e > worst)
+        worst = e;
+  }
+  return worst;
+}
+
+static float f_atan(float x){ return f_atan2(x,1.0); }
+
+static void test_trig(){
+double e;
+  e = max_error(f_sin,sin,-2.0 * M_PI,2.0 * M_PI,2000000);
+  printf("f_sin  |x|<=2pi %.2e\n",e);
+  CHECK(e < 1e-7);
+  e = max_error(f_cos,cos,-2.0 * M_PI,2.0 * M_PI,2000000);
+  printf("f_cos  |x|<=2pi %.2e\n",e);
+  CHECK(e < 1e-7);
+  e = max_error(f_sin,sin,-100.0,100.0,2000000);
+  printf("f_sin  |x|<=100 %.2e\n",e);
+  CHECK(e < 1e-7);
+  e = max_error(f_cos,cos,-100.0,100.0,2000000);
+  printf("f_cos  |x|<=100 %.2e\n",e);
+  CHECK(e < 1e-7);
+  e = max_error(f_atan,atan,-50.0,50.0,2000000);
+  printf("f_atan2         %.2e\n",e);
+  CHECK(e < 2e-7);
+}
+
+//every float in range against the C99 halves away from 0 lroundf
+static void test_lround(){
+union{ float f; unsigned int u; }v;
+unsigned int u,bad;
+  bad = 0;
+  for(u = 0; u < 0x4F000000; u++){
+     v.u = u;
+     if(fw_lround(v.f) != (int)lroundf(v.f))
+        bad++;
+     v.u = u | 0x80000000;
+     if(fw_lround(v.f) != (int)lroundf(v.f))
+        bad++;
+  }
+  printf("lround    %u wrong of every float |x| < 2^31\n",bad);
+  CHECK(bad == 0);
+}
+
+//every finite float against the C library float versions
+static void test_floor_ceil(){
+union{ float f; unsigned int u; }v;
+unsigned int u,bad;
+  bad = 0;
+  for(u = 0; u < 0x7F800000; u++){
+     v.u = u;
+     if((f_floor(v.f) != floorf(v.f)) || (f_ceil(v.f) != ceilf(v.f)) ||
+        (f_fabs(v.f) != v.f))
+        bad++;
+     v.u = u | 0x80000000;
+     if((f_floor(v.f) != floorf(v.f)) || (f_ceil(v.f) != ceilf(v.f)) ||
+        (f_fabs(v.f) != fabsf(v.f)))
+        bad++;
+  }
+  printf("f_floor, f_ceil, f_fabs %u wrong of every finite float\n",bad);
+  CHECK(bad == 0);
+}
+
+//every float in the Q16.16 range, and the clamps either side
+static void test_flt2q16(){
+union{ float f; unsigned int u; }v;
+unsigned int u,bad;
+  bad = 0;
+  for(u = 0; u < 0x47000000; u++){
+     v.u = u;
+     if(flt2q16(v.f) != (int)llround((double)v.f * 65536.0))
+        bad++;
+     v.u = u | 0x80000000;
+     if(flt2q16(v.f) != (int)llround((double)v.f * 65536.0))
+        bad++;
+  }
+  //-32768 itself is the last value in range
+  if(flt2q16(-32768.0) != (int)0x80000000)
+     bad++;
+  printf("flt2q16   %u wrong of every float |x| < 32768\n",bad);
+  CHECK(bad == 0);
+  CHECK(flt2q16(32768.0) == 0x7FFFFFFF);
+  CHECK(flt2q16(1e9) == 0x7FFFFFFF);
+  CHECK(flt2q16(-1e9) == (int)0x80000000);
+}
+
+//a*b/2^32 rounded halves away from 0, against 64 bit maths
+static int q16_mul_ref(int a,int b){
+int64_t p;
+  p = (int64_t)a * b;
+  if(p < 0)
+     return -(int)((-p + 0x80000000LL) >> 32);
+  return (int)((p + 0x80000000LL) >> 32);
+}
+
+static void test_q16_mul_int(){
+const int edge[] = {0,1,-1,0x7FFF,0x8000,0xFFFF,0x10000,-0x10000,0x18000,-0x18000,
+                    0x7FFFFFFF,-0x7FFFFFFF,0x40000000,-0x40000000,0x12345678,-0x0FEDCBA9};
+unsigned int seed,bad;
+int i,j,a,b;
+  bad = 0;
+  for(i = 0; i < 16; i++){
+     for(j = 0; j < 16; j++){
+        if(q16_mul_int(edge[i],edge[j]) != q16_mul_ref(edge[i],edge[j]))
+           bad++;
+     }
+  }
+  seed = 12345;
+  for(i = 0; i < 10000000; i++){
+     seed = seed * 1664525 + 1013904223;
+     a = (int)seed >> (seed & 15);
+     seed = seed * 1664525 + 1013904223;
+     b = (int)seed >> (seed & 15);
+     if(a == (int)0x80000000 || b == (int)0x80000000)
+        continue;
+     if(q16_mul_int(a,b) != q16_mul_ref(a,b))
+        bad++;
+  }
+  //exact halves round away from 0 whatever the sign
+  CHECK(q16_mul_int(0x8000,0x10000) == 1);
+  CHECK(q16_mul_int(-0x8000,0x10000) == -1);
+  printf("q16_mul   %u wrong of 256 edge pairs and 10M random\n",bad);
+  CHECK(bad == 0);
+}
+
+static void test_q16_to_str(){
+char str[16];
+  q16_to_str(-1,str,3);
+  CHECK(strcmp(str,"0.000") == 0);
+  q16_to_str(-1,str,0);
+  CHECK(strcmp(str,"0") == 0);
+  q16_to_str(-0x8000,str,0);
+  CHECK(strcmp(str,"-1") == 0);
+  q16_to_str(-33,str,4);
+  CHECK(strcmp(str,"-0.0005") == 0);
+  q16_to_str(-3,str,4);
+  CHECK(strcmp(str,"0.0000") == 0);
+  q16_to_str(flt2q16(-12.3456),str,2);
+  CHECK(strcmp(str,"-12.35") == 0);
+  q16_to_str(flt2q16(9.99996),str,4);
+  CHECK(strcmp(str,"10.0000") == 0);
+  q16_to_str(0x7FFFFFFF,str,4);
+  CHECK(strcmp(str,"32768.0000") == 0);
+}
+
+static void test_read_float(){
+char line[] = "X10Y-5.25Z+.5A1.F1234567890.5P-0.000001Q";
+//digits past the 8th are dropped as grbl does
+const float expect[6] = {10.0,-5.25,0.5,1.0,1234567800.0,-0.000001};
+float value;
+int char_counter,i;
+  char_counter = 0;
+  for(i = 0; i < 6; i++){
+     char_counter++;
+     CHECK(read_float(line,&char_counter,&value));
+     CHECK(fabs(value - expect[i]) <= fabs(expect[i]) * 1e-7);
+  }
+  //Q with no number after it
+  char_counter++;
+  CHECK(!read_float(line,&char_counter,&value));
+  CHECK(char_counter == (int)strlen(line));
+  char_counter = 0;
+  CHECK(!read_float("-.X",&char_counter,&value));
+  CHECK(char_counter == 0);
+}
+
+int main(){
+  test_trig();
+  test_lround();
+  test_floor_ceil();
+  test_flt2q16();
+  test_q16_mul_int();
+  test_q16_to_str();
+  test_read_float();
+  return host_failures != 0;
+}
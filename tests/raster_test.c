@@ -0,0 +1,110 @@
+//Raster.c slots and the Motion.c scan line blocks of G7 lines
+#include "host.h"
+#include "../Nuts_Bolts.h"
+#include "../Planner.h"
+#include "../Raster.h"
+
+#define SPINDLE_OFF 0
+#define LASER_MODE  0
+#define STEPS_PER_MM 80.0
+unsigned int spindle_get_duty(float rpm){ return (unsigned int)rpm; }
+void st_prep_buffer(){}
+void st_wake_up(){}
+int  st_is_busy(){ return 0; }
+int  st_is_held(){ return 0; }
+
+//blocks queued, with the raster slot each was stamped with
+static float queued[16][N_AXIS];
+static int queued_raster[16],n_queued,pl_raster = RASTER_NONE;
+
+int plan_buffer_line(float *target,float feed_rate){
+  memcpy(queued[n_queued],target,sizeof(queued[0]));
+  queued_raster[n_queued++] = pl_raster;
+  return 1;
+}
+int  plan_buffer_dwell(float seconds){ return 1; }
+void plan_set_spindle(int state,unsigned int duty){}
+int  plan_get_spindle_state(){ return 0; }
+unsigned int plan_get_spindle_duty(){ return 0; }
+void plan_set_raster(int slot){ pl_raster = slot; }
+int  plan_check_full_buffer(){ return 0; }
+Block *plan_get_current_block(){ return NULL; }
+float plan_get_max_rate(int axis){ return 3000.0; }
+float plan_get_acceleration(int axis){ return 250.0; }
+long plan_mm_to_steps(float mm,int axis){ return lround(mm * STEPS_PER_MM); }
+void plan_get_position(float *position){
+  if(n_queued)
+     memcpy(position,queued[n_queued-1],sizeof(queued[0]));
+  else
+     memset(position,0,sizeof(queued[0]));
+}
+
+#include "../Nut_Bolts.c"
+#include "../Motion.c"
+#include "../Raster.c"
+
+//a scan line that queues lead in, start, scan and lead out, with
+//only the scan stamped with the slot
+static void check_line(float *start,float *target,int slot){
+int i;
+  CHECK(n_queued == 4);
+  for(i = 0; i < N_AXIS; i++){
+     CHECK(queued[1][i] == start[i]);
+     CHECK(queued[2][i] == target[i]);
+  }
+  //the lead in runs into start along the line
+  CHECK((queued[0][X_AXIS] - start[X_AXIS]) * (target[X_AXIS] - start[X_AXIS]) < 0.0);
+  CHECK(queued[0][Y_AXIS] == start[Y_AXIS]);
+  CHECK(queued_raster[0] == RASTER_NONE);
+  CHECK(queued_raster[1] == RASTER_NONE);
+  CHECK(queued_raster[2] == slot);
+  CHECK(queued_raster[3] == RASTER_NONE);
+}
+
+int main(){
+float start[N_AXIS] = {0.0,0.0,0.0,0.0};
+float target[N_AXIS] = {10.0,0.0,0.0,0.0};
+int i;
+  CHECK(raster_line(start,target,600.0,1000.0,"AP8A"));
+  check_line(start,target,0);
+  CHECK((raster.count == 1) && (raster_get_count(0) == 3));
+  CHECK(raster_get_pixels(0)[1] == 0xFF);
+
+  //the next line starts where the program put the last one and not
+  //at the end of its lead out, where the queue ends
+  memcpy(start,target,sizeof(start));
+  start[Y_AXIS] = target[Y_AXIS] = 0.1;
+  target[X_AXIS] = 0.0;
+  n_queued = 0;
+  CHECK(raster_line(start,target,600.0,1000.0,"/w=="));
+  check_line(start,target,1);
+  CHECK((raster.count == 2) && (raster.head == 2));
+
+  //less than a step queues nothing and gives the slot back
+  memcpy(start,target,sizeof(start));
+  target[X_AXIS] += (float)0.4 / STEPS_PER_MM;
+  n_queued = 0;
+  CHECK(!raster_line(start,target,600.0,1000.0,"AAAA"));
+  CHECK(n_queued == 0);
+  CHECK((raster.count == 2) && (raster.head == 2));
+
+  //bad data takes no slot
+  target[X_AXIS] = 5.0;
+  CHECK(!raster_line(start,target,600.0,1000.0,"*"));
+  CHECK((raster.count == 2) && (raster.head == 2));
+
+  //the stepper freeing both lines leaves every slot for use
+  raster_release();
+  raster_release();
+  raster_release();
+  CHECK((raster.count == 0) && (raster.tail == 2));
+  for(i = 0; i < RASTER_BUFFER_SIZE; i++){
+     n_queued = 0;
+     target[Y_AXIS] += 0.1;
+     CHECK(raster_line(start,target,600.0,1000.0,"AA"));
+     memcpy(start,target,sizeof(start));
+  }
+  CHECK(raster.count == RASTER_BUFFER_SIZE);
+  printf("raster slots %s\n",host_failures? "failed" : "ok");
+  return host_failures != 0;
+}
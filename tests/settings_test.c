@@ -0,0 +1,236 @@
+//Settings.c flash log on a file mapped as the two pages. The power
+//is cut part way through erases and quad word writes by ending a
+//child process, the restart maps the file again.
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include "host.h"
+#include "../Nuts_Bolts.h"
+#include "../Settings.h"
+
+void plan_update_settings(){}
+void st_set_pulse_timing(float pulse_us,float dir_setup_us){}
+
+//both pages, SETTINGS_PAGE_1 follows SETTINGS_PAGE_0
+#define FLASH_SIZE (2 * SETTINGS_PAGE_SIZE)
+static char flash_file[] = "/tmp/settings_flash_XXXXXX";
+static unsigned int *flash;
+#define SETTINGS_NVM_STUB
+#define FLASH_PTR(pa) (&flash[((pa) - SETTINGS_PAGE_0) / 4])
+
+static int ops_left;          //flash operations before the power goes, -1 never
+static unsigned int seed = 1;
+static int n_erase,n_write;
+
+static unsigned int rnd(){
+  seed = seed * 1664525 + 1013904223;
+  return seed >> 8;
+}
+
+//counts down the operations, on the last one it is left part done
+static int power_fails(){
+  if(ops_left < 0)
+     return 0;
+  return ops_left-- == 0;
+}
+
+//the child ends with the flash as the cut left it in the file
+static void power_cut(){
+  _exit(host_failures? 1 : 0);
+}
+
+//maps the file afresh, as the flash is found after a restart
+static void flash_map(){
+int fd;
+  if(flash)
+     munmap(flash,FLASH_SIZE);
+  fd = open(flash_file,O_RDWR);
+  flash = mmap(NULL,FLASH_SIZE,PROT_READ | PROT_WRITE,MAP_SHARED,fd,0);
+  close(fd);
+  if(flash == MAP_FAILED){
+     perror(flash_file);
+     exit(1);
+  }
+}
+
+static int flash_erase_page(unsigned int page){
+unsigned int *w;
+int i;
+  w = FLASH_PTR(page);
+  if(power_fails()){
+     for(i = 0; i < SETTINGS_PAGE_SIZE / 4; i++){
+        if(rnd() & 1)
+           w[i] = 0xFFFFFFFF;
+     }
+     power_cut();
+  }
+  for(i = 0; i < SETTINGS_PAGE_SIZE / 4; i++)
+     w[i] = 0xFFFFFFFF;
+  n_erase++;
+  return 1;
+}
+
+//programming only clears bits, a cut leaves the words from a
+//random one on unwritten or half written
+static int flash_write_quad(unsigned int addr,unsigned int *data){
+unsigned int *w;
+int i,k;
+  w = FLASH_PTR(addr);
+  if(power_fails()){
+     k = rnd() % 4;
+     for(i = 0; i < k; i++)
+        w[i] &= data[i];
+     w[k] &= data[k] | (rnd() ^ (rnd() << 12));
+     power_cut();
+  }
+  for(i = 0; i < 4; i++)
+     w[i] &= data[i];
+  n_write++;
+  return 1;
+}
+
+#include "../Nut_Bolts.c"
+#include "../Settings.c"
+
+//what the settings must read back as
+static Settings expect;
+
+static void reboot(){
+  memset(&settings,0x55,sizeof(settings));
+  settings_init();
+}
+
+static int settings_match(){
+  return memcmp(&settings,&expect,sizeof(Settings)) == 0;
+}
+
+static void set(int id,float value){
+  ((float*)&expect)[id] = value;
+  CHECK(settings_write(id,value));
+}
+
+static void test_replay(){
+  memset(flash,0xFF,FLASH_SIZE);
+  ops_left = -1;
+  reboot();
+  memcpy(&expect,&settings_default,sizeof(Settings));
+  CHECK(settings_match());
+  set(SETTING_STEPS_PER_MM + Y_AXIS,80.0);
+  set(SETTING_ACCELERATION,1234.5);
+  set(SETTING_COORD_DATA + 5,-12.25);
+  set(SETTING_STEPS_PER_MM + Y_AXIS,81.0);
+  reboot();
+  CHECK(settings_match());
+  //back to the default is kept as a record too
+  set(SETTING_ACCELERATION,DEFAULT_X_ACCELERATION);
+  reboot();
+  CHECK(settings_match());
+  printf("replay     %s\n",settings_match()? "ok" : "wrong");
+}
+
+//many writes, the log changes page and erases the old one in turn
+static void test_compaction(){
+int i,id,erases;
+  memset(flash,0xFF,FLASH_SIZE);
+  ops_left = -1;
+  reboot();
+  memcpy(&expect,&settings_default,sizeof(Settings));
+  n_erase = 0;
+  for(i = 0; i < 5000; i++){
+     id = rnd() % SETTING_COUNT;
+     set(id,(float)(rnd() % 1000) * 0.25);
+     if((i % 97) == 0){
+        reboot();
+        CHECK(settings_match());
+     }
+  }
+  erases = n_erase;
+  reboot();
+  CHECK(settings_match());
+  printf("compaction %d writes, %d page erases, %s\n",5000,erases,settings_match()? "ok" : "wrong");
+  CHECK(erases >= 2);
+}
+
+/* Cut the power at each flash operation in turn over a run of
+ * writes that goes through several compactions. The writes run in a
+ * child and the cut ends it, the setting being written when it went
+ * is left in shared memory. After the restart every setting must
+ * read as it was, except that one which may read as either its old
+ * or new value, and the log must keep working.
+ */
+static struct{
+ Settings before;
+ int id;
+ float value;
+}*cut_at;
+
+static void test_torn_writes(){
+int cut,i,failed,restarts,status;
+pid_t pid;
+  cut_at = mmap(NULL,sizeof(*cut_at),PROT_READ | PROT_WRITE,MAP_SHARED | MAP_ANONYMOUS,-1,0);
+  failed = restarts = 0;
+  for(cut = 0; cut < 4000; cut++){
+     memset(flash,0xFF,FLASH_SIZE);
+     seed = 7;
+     ops_left = -1;
+     reboot();
+     memcpy(&expect,&settings_default,sizeof(Settings));
+     fflush(stdout);
+     pid = fork();
+     if(pid == 0){
+        ops_left = cut;
+        for(i = 0; i < 3000; i++){
+           cut_at->id = rnd() % SETTING_COUNT;
+           cut_at->value = (float)(rnd() % 1000) * 0.5;
+           memcpy(&cut_at->before,&expect,sizeof(Settings));
+           set(cut_at->id,cut_at->value);
+        }
+        //every write went in before the cut point
+        _exit(host_failures? 1 : 2);
+     }
+     waitpid(pid,&status,0);
+     if(!WIFEXITED(status) || (WEXITSTATUS(status) == 1)){
+        failed++;
+        continue;
+     }
+     if(WEXITSTATUS(status) == 2)
+        continue;
+     //power is back
+     restarts++;
+     flash_map();
+     reboot();
+     memcpy(&expect,&cut_at->before,sizeof(Settings));
+     if(!settings_match()){
+        ((float*)&expect)[cut_at->id] = cut_at->value;
+        if(!settings_match()){
+           failed++;
+           printf("  cut at op %d lost a setting\n",cut);
+        }
+     }
+     memcpy(&expect,&settings,sizeof(Settings));
+     for(i = 0; i < 600; i++)
+        set(rnd() % SETTING_COUNT,(float)i);
+     reboot();
+     if(!settings_match())
+        failed++;
+  }
+  printf("torn write %d cut points, %d restarts, %d wrong\n",cut,restarts,failed);
+  CHECK(failed == 0);
+}
+
+int main(){
+int fd;
+  fd = mkstemp(flash_file);
+  if((fd < 0) || (ftruncate(fd,FLASH_SIZE) != 0)){
+     perror(flash_file);
+     return 1;
+  }
+  close(fd);
+  flash_map();
+  test_replay();
+  test_compaction();
+  test_torn_writes();
+  unlink(flash_file);
+  return host_failures != 0;
+}
@@ -0,0 +1,162 @@
+//Shaper.c impulse response, and a move run through a damped
+//resonance with and without shaping
+#include "host.h"
+#define PINS_H
+#define TIMERS_H
+#define SERIAL_DMA_H
+#define AXIS_H
+#include "../Nuts_Bolts.h"
+#include "../Steppers.h"
+#include "../Shaper.h"
+#include "../Nut_Bolts.c"
+#include "../Shaper.c"
+
+#define N_SLICE 1024
+
+//shaped output of one unit slice followed by stillness
+static int impulse_response(float *out){
+float ds;
+int n;
+  ds = 1.0;
+  n = 0;
+  while(shaper_slice(&ds) && (n < N_SLICE)){
+     out[n++] = ds;
+     ds = 0.0;
+  }
+  return n;
+}
+
+//the impulses from the formulas in double, spread over the two
+//slices either side of a fractional delay
+static void expected_response(int type,double freq,double z,double *out){
+double k,td,amp[3],sum,d,f;
+int i,n,j;
+  memset(out,0,N_SLICE * sizeof(double));
+  k  = exp(-z * M_PI / sqrt(1.0 - z * z));
+  td = 1.0 / (freq * sqrt(1.0 - z * z));
+  amp[0] = 1.0;
+  if(type == SHAPER_ZV){
+     amp[1] = k;
+     n = 2;
+  }else if(type == SHAPER_EI){
+     amp[0] = 0.25 * (1.0 + SHAPER_EI_VTOL);
+     amp[1] = 0.5 * (1.0 - SHAPER_EI_VTOL) * k;
+     amp[2] = amp[0] * k * k;
+     n = 3;
+  }else{
+     amp[1] = 2.0 * k;
+     amp[2] = k * k;
+     n = 3;
+  }
+  sum = 0.0;
+  for(i = 0; i < n; i++)
+     sum += amp[i];
+  for(i = 0; i < n; i++){
+     d = 0.5 * i * td / SEGMENT_DT;
+     j = (int)d;
+     f = d - j;
+     out[j] += (1.0 - f) * amp[i] / sum;
+     out[j + 1] += f * amp[i] / sum;
+  }
+}
+
+static void test_impulse(int type,const char *name){
+static float out[N_SLICE];
+static double expect[N_SLICE];
+double sum,err;
+int n,i;
+  CHECK(shaper_set(type,DEFAULT_SHAPER_FREQ,DEFAULT_SHAPER_DAMPING));
+  n = impulse_response(out);
+  expected_response(type,DEFAULT_SHAPER_FREQ,DEFAULT_SHAPER_DAMPING,expect);
+  sum = 0.0;
+  err = 0.0;
+  for(i = 0; i < n; i++){
+     sum += out[i];
+     err = fmax(err,fabs(out[i] - expect[i]));
+  }
+  printf("%-4s impulse: %d slices, area %.6f, max error %.1e\n",name,n,sum,err);
+  //no distance is lost and every slice is where the formulas put it
+  CHECK(fabs(sum - 1.0) < 1e-5);
+  CHECK(err < 1e-5);
+}
+
+/* Slices of a 10 mm move at 100 mm/s and 2500 mm/s^2 through the
+ * shaper, then a base excited resonance at freq and damping z
+ * stepped at 1/20 of a slice. Returns the peak error of the
+ * resonance once the commanded move has ended.
+ */
+#define MOVE_V  100.0
+#define MOVE_A  2500.0
+#define MOVE_TA (MOVE_V / MOVE_A)
+#define MOVE_TC ((10.0 - MOVE_V * MOVE_TA) / MOVE_V)
+
+//planned position at t on the trapezoid
+static double move_position(double t){
+  if(t < MOVE_TA)
+     return 0.5 * MOVE_A * t * t;
+  t -= MOVE_TA;
+  if(t < MOVE_TC)
+     return 0.5 * MOVE_V * MOVE_TA + MOVE_V * t;
+  t = MOVE_TA - (t - MOVE_TC);
+  if(t > 0.0)
+     return 10.0 - 0.5 * MOVE_A * t * t;
+  return 10.0;
+}
+
+static double residual(int shaped,double freq,double z){
+double x,x_prev,v_cmd,y,vy,w,t,h,peak;
+float ds;
+int n,i,moving;
+  if(shaped)
+     shaper_set(SHAPER_ZVD,DEFAULT_SHAPER_FREQ,DEFAULT_SHAPER_DAMPING);
+  else
+     shaper_set(SHAPER_ZVD,0.0,0.0);
+  w = 2.0 * M_PI * freq;
+  x = y = vy = 0.0;
+  peak = 0.0;
+  h = SEGMENT_DT / 20.0;
+  moving = 1;
+  for(n = 0; n < 4000; n++){
+     t = n * SEGMENT_DT;
+     ds = move_position(t + SEGMENT_DT) - move_position(t);
+     if(moving && !shaper_slice(&ds))
+        moving = 0;
+     if(!moving)
+        ds = 0.0;
+     v_cmd = ds / SEGMENT_DT;
+     x_prev = x;
+     for(i = 0; i < 20; i++){
+        x = x_prev + v_cmd * h * (i + 1);
+        vy += h * (-w * w * (y - x) - 2.0 * z * w * (vy - v_cmd));
+        y  += h * vy;
+     }
+     if(fabs(x - 10.0) < 1e-4)
+        peak = fmax(peak,fabs(y - x));
+  }
+  CHECK(fabs(x - 10.0) < 1e-4);
+  return peak;
+}
+
+static void test_residual(){
+const double scale[3] = {0.8,1.0,1.2};
+double r0,r1;
+int i;
+  printf("residual after a 10 mm move, ZVD tuned to %.0f Hz\n",DEFAULT_SHAPER_FREQ);
+  for(i = 0; i < 3; i++){
+     r0 = residual(0,scale[i] * DEFAULT_SHAPER_FREQ,DEFAULT_SHAPER_DAMPING);
+     r1 = residual(1,scale[i] * DEFAULT_SHAPER_FREQ,DEFAULT_SHAPER_DAMPING);
+     printf("  resonance %4.0f Hz  unshaped %.4f mm  shaped %.4f mm\n",
+            scale[i] * DEFAULT_SHAPER_FREQ,r0,r1);
+     CHECK(r1 < 0.15 * r0);
+  }
+}
+
+int main(){
+  test_impulse(SHAPER_ZV,"ZV");
+  test_impulse(SHAPER_ZVD,"ZVD");
+  test_impulse(SHAPER_EI,"EI");
+  //a delay past the history is refused and shaping left off
+  CHECK(!shaper_set(SHAPER_ZVD,5.0,0.1));
+  test_residual();
+  return host_failures != 0;
+}